@@ -0,0 +1,175 @@
+#pragma once
+#include "../utils.hh"
+#include "dataflow_analysis.hh"
+
+namespace whilelang {
+    using namespace trieste;
+
+    enum class ACAbstractType { Bottom, Copy, Top };
+
+    // The variable holding a copy of source on every path reaching a program
+    // point. Bottom is used for points not yet reached, so that the join of
+    // the solver computes the intersection of the copies of all paths.
+    struct ACLatticeValue {
+        ACAbstractType type;
+        std::optional<std::string> source;
+
+        inline bool operator==(const ACLatticeValue &other) const {
+            if (type == other.type) {
+                if (type == ACAbstractType::Copy) {
+                    return source == other.source;
+                } else {
+                    return true;
+                }
+            }
+            return false;
+        }
+
+        ACLatticeValue join(const ACLatticeValue &other) const {
+            if (this->type == ACAbstractType::Bottom) {
+                return other;
+            } else if (other.type == ACAbstractType::Bottom) {
+                return *this;
+            } else if (*this == other) {
+                return *this;
+            }
+
+            return ACLatticeValue::top();
+        }
+
+        friend std::ostream &
+        operator<<(std::ostream &os, const ACLatticeValue &lattice_value) {
+            switch (lattice_value.type) {
+                case ACAbstractType::Top:
+                    os << "?";
+                    break;
+                case ACAbstractType::Copy:
+                    os << *lattice_value.source;
+                    break;
+                case ACAbstractType::Bottom:
+                    os << "B";
+                    break;
+            }
+            return os;
+        }
+
+        static ACLatticeValue top() {
+            return {ACAbstractType::Top, std::nullopt};
+        }
+        static ACLatticeValue bottom() {
+            return {ACAbstractType::Bottom, std::nullopt};
+        }
+        static ACLatticeValue copy(const std::string &source) {
+            return {ACAbstractType::Copy, source};
+        }
+    };
+
+    using ACState = std::pmr::map<std::string, ACLatticeValue>;
+
+    ACState ac_first_state(std::shared_ptr<ControlFlow> cfg) {
+        ACState first_state(cfg->get_arena()->resource());
+
+        for (const auto &var : cfg->get_vars()) {
+            first_state[var] = ACLatticeValue::top();
+        }
+        return first_state;
+    }
+
+    // Assigning var invalidates its own copy and every copy of it
+    void ac_kill(ACState &state, const std::string &var) {
+        for (auto &[_, value] : state) {
+            if (value.type == ACAbstractType::Copy && *value.source == var) {
+                value = ACLatticeValue::top();
+            }
+        }
+        state[var] = ACLatticeValue::top();
+    }
+
+    struct ACImpl {
+        using StateTable = std::pmr::map<Node, ACState>;
+
+        static ACState
+        create_state(const Vars &vars, std::pmr::memory_resource *resource) {
+            ACState state(resource);
+
+            for (const auto &var : vars) {
+                state[var] = ACLatticeValue::bottom();
+            }
+            return state;
+        }
+
+        static bool state_join(ACState &x, const ACState &y) {
+            bool changed = false;
+
+            auto it1 = x.begin();
+            auto it2 = y.begin();
+
+            while (it1 != x.end() && it2 != y.end()) {
+                auto join_res = it1->second.join(it2->second);
+
+                if (join_res != it1->second) {
+                    it1->second = join_res;
+                    changed = true;
+                }
+                it1++;
+                it2++;
+            }
+
+            return changed;
+        }
+
+        static ACState flow(
+            const Node &inst,
+            StateTable &state_table,
+            std::shared_ptr<ControlFlow>) {
+            const auto &state = state_table[inst];
+            ACState incoming_state(state, state.get_allocator());
+
+            if (inst == Assign) {
+                auto var = get_identifier(inst / Ident);
+                auto expr = (inst / Rhs) / Expr;
+
+                if (expr == FunCall) {
+                    // The callee runs in its own frame, so the copies of the
+                    // call site are still available after it returns
+                    ACState post_call_state(
+                        state_table[expr], state.get_allocator());
+                    ac_kill(post_call_state, var);
+                    return post_call_state;
+                }
+
+                auto value = ACLatticeValue::top();
+                if (expr == Atom && expr / Expr == Ident) {
+                    // Chains of copies are resolved to the first source
+                    auto source = get_identifier(expr / Expr);
+                    const auto &source_value = incoming_state[source];
+
+                    if (source_value.type == ACAbstractType::Copy) {
+                        source = *source_value.source;
+                    }
+                    if (source != var) {
+                        value = ACLatticeValue::copy(source);
+                    }
+                }
+
+                ac_kill(incoming_state, var);
+                incoming_state[var] = value;
+            } else if (
+                inst == FunDef &&
+                get_identifier((inst / FunId) / Ident) != "main") {
+                // No copies are available when entering a function
+                for (auto &[_, value] : incoming_state) {
+                    value = ACLatticeValue::top();
+                }
+            }
+            return incoming_state;
+        }
+    };
+
+    std::ostream &operator<<(std::ostream &os, const ACState &state) {
+        for (const auto &[_, value] : state) {
+            os << std::setw(PRINT_WIDTH) << value;
+        }
+        return os;
+    }
+}
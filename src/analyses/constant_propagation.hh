@@ -70,24 +70,26 @@ namespace whilelang {
         }
     };
 
-    using CPState = std::map<std::string, CPLatticeValue>;
+    using CPState = std::pmr::map<std::string, CPLatticeValue>;
 
-    CPLatticeValue atom_flow_helper(Node inst, CPState incoming_state) {
+    inline CPLatticeValue
+    atom_flow_helper(Node inst, const CPState &incoming_state) {
         if (inst == Atom) {
             Node expr = inst / Expr;
 
             if (expr == Int) {
                 return CPLatticeValue::constant(get_int_value(expr));
             } else if (expr == Ident) {
-                std::string rhs_ident = get_identifier(expr);
-                return incoming_state[rhs_ident];
+                auto res = incoming_state.find(get_identifier(expr));
+                return res != incoming_state.end() ? res->second
+                                                   : CPLatticeValue::bottom();
             }
         }
 
         return CPLatticeValue::top();
     }
 
-    int apply_arith_op(Node op, int x, int y) {
+    inline int apply_arith_op(Node op, int x, int y) {
         if (op == Add) {
             return x + y;
         } else if (op == Sub) {
@@ -101,7 +103,7 @@ namespace whilelang {
         }
     };
 
-    CPState cp_first_state(std::shared_ptr<ControlFlow> cfg) {
+    inline CPState cp_first_state(std::shared_ptr<ControlFlow> cfg) {
         auto first_state = CPState();
 
         for (auto var : cfg->get_vars()) {
@@ -111,10 +113,11 @@ namespace whilelang {
     }
 
     struct CPImpl {
-		using StateTable = NodeMap<CPState>;
+		using StateTable = std::pmr::map<Node, CPState>;
 
-        static CPState create_state(const Vars &vars) {
-            CPState state = CPState();
+        static CPState
+        create_state(const Vars &vars, std::pmr::memory_resource *resource) {
+            CPState state(resource);
 
             for (auto var : vars) {
                 state[var] = CPLatticeValue::bottom();
@@ -150,7 +153,9 @@ namespace whilelang {
             const Node &inst,
             StateTable &state_table,
             std::shared_ptr<ControlFlow> cfg) {
-            auto incoming_state = state_table[inst];
+            // Copies keep the allocator of the state table
+            const auto &state = state_table[inst];
+            CPState incoming_state(state, state.get_allocator());
 
             if (inst == Assign) {
                 std::string var = get_identifier(inst / Ident);
@@ -177,7 +182,7 @@ namespace whilelang {
                     }
                 } else {
                     // Is function call
-                    auto prevs = cfg->predecessors(inst);
+                    const auto &prevs = cfg->predecessors(inst);
                     CPLatticeValue val = CPLatticeValue::bottom();
 
                     // Join result of all return statements
@@ -187,7 +192,8 @@ namespace whilelang {
                                 prev / Atom, state_table[prev]));
                         }
                     }
-                    auto pre_fun_call_state = state_table[expr];
+                    CPState pre_fun_call_state(
+                        state_table[expr], state.get_allocator());
                     pre_fun_call_state[var] = val;
                     return pre_fun_call_state;
                 }
@@ -224,7 +230,7 @@ namespace whilelang {
         }
     };
 
-    std::ostream &operator<<(std::ostream &os, const CPState &state) {
+    inline std::ostream &operator<<(std::ostream &os, const CPState &state) {
         for (const auto &[_, value] : state) {
             os << std::setw(PRINT_WIDTH) << value;
         }
@@ -0,0 +1,250 @@
+#pragma once
+#include "../utils.hh"
+#include "constant_propagation.hh"
+
+#include <unordered_map>
+
+namespace whilelang {
+    using namespace trieste;
+
+    // Answers whether a variable is constant when an instruction is reached,
+    // without solving the whole program. A query only explores the
+    // definitions the value can depend on, solves that part of the equation
+    // system with a local worklist and memoizes every value it resolves.
+    //
+    // The equations are the ones of the constant propagation in CPImpl:
+    //   in(n, v)  = top at the program entry, otherwise the join of
+    //               out(p, v) over all predecessors p of n
+    //   out(p, v) = the flow of p applied to in(p, _), restricted to v
+    class ConstantQuery {
+      public:
+        ConstantQuery(std::shared_ptr<ControlFlow> cfg) : cfg(cfg) {}
+
+        // Must be called whenever the control flow graph has been rebuilt
+        void reset() {
+            memo.clear();
+            var_names.assign(cfg->get_vars().begin(), cfg->get_vars().end());
+            var_ids.clear();
+
+            for (size_t i = 0; i < var_names.size(); i++) {
+                var_ids.insert({var_names[i], i});
+            }
+        }
+
+        // The value of var on entry to the instruction
+        CPLatticeValue value_at(const Node &inst, const std::string &var) {
+            auto var_id = var_ids.find(var);
+            if (var_id == var_ids.end()) {
+                return CPLatticeValue::top();
+            }
+
+            auto query = key(cfg->get_id(inst), var_id->second);
+            auto res = memo.find(query);
+            if (res != memo.end()) {
+                return res->second;
+            }
+
+            solve(query);
+            return memo.at(query);
+        }
+
+        inline size_t resolved_values() {
+            return memo.size();
+        }
+
+      private:
+        std::shared_ptr<ControlFlow> cfg;
+        std::unordered_map<size_t, CPLatticeValue> memo;
+        std::vector<std::string> var_names;
+        std::unordered_map<std::string, size_t> var_ids;
+
+        inline size_t key(size_t id, size_t var) {
+            return id * var_names.size() + var;
+        }
+
+        // Explores every unresolved value the query depends on and then
+        // iterates over only those values until a fixpoint is reached
+        void solve(size_t query) {
+            std::unordered_map<size_t, size_t> local_ids;
+            std::vector<size_t> keys;
+            std::vector<std::vector<size_t>> dependents;
+
+            auto add_local = [&](size_t k) {
+                auto [it, inserted] = local_ids.insert({k, keys.size()});
+                if (inserted) {
+                    keys.push_back(k);
+                    dependents.push_back({});
+                }
+                return std::pair{it->second, inserted};
+            };
+
+            add_local(query);
+            for (size_t i = 0; i < keys.size(); i++) {
+                // The lookup only records dependencies while exploring
+                auto explore = [&](size_t id, size_t var) {
+                    auto k = key(id, var);
+                    auto res = memo.find(k);
+                    if (res != memo.end()) {
+                        return res->second;
+                    }
+
+                    auto [local, _] = add_local(k);
+                    dependents[local].push_back(i);
+                    return CPLatticeValue::bottom();
+                };
+                in_value(keys[i], explore);
+            }
+
+            std::vector<CPLatticeValue> values(
+                keys.size(), CPLatticeValue::bottom());
+            std::vector<bool> in_worklist(keys.size(), true);
+            std::deque<size_t> worklist(keys.size());
+            std::iota(worklist.begin(), worklist.end(), 0);
+
+            auto lookup = [&](size_t id, size_t var) {
+                auto k = key(id, var);
+                auto res = memo.find(k);
+                if (res != memo.end()) {
+                    return res->second;
+                }
+                return values[local_ids.at(k)];
+            };
+
+            while (!worklist.empty()) {
+                size_t local = worklist.front();
+                worklist.pop_front();
+                in_worklist[local] = false;
+
+                auto new_value =
+                    values[local].join(in_value(keys[local], lookup));
+
+                if (new_value != values[local]) {
+                    values[local] = new_value;
+
+                    for (size_t dependent : dependents[local]) {
+                        if (!in_worklist[dependent]) {
+                            in_worklist[dependent] = true;
+                            worklist.push_back(dependent);
+                        }
+                    }
+                }
+            }
+
+            for (size_t local = 0; local < keys.size(); local++) {
+                memo.insert({keys[local], values[local]});
+            }
+        }
+
+        template<typename Lookup>
+        CPLatticeValue in_value(size_t k, Lookup &in) {
+            size_t id = k / var_names.size();
+            size_t var = k % var_names.size();
+
+            if (cfg->get_node(id) == cfg->get_program_entry()) {
+                return CPLatticeValue::top();
+            }
+
+            auto value = CPLatticeValue::bottom();
+            for (size_t pred : cfg->predecessor_ids(id)) {
+                value = value.join(out_value(pred, var, in));
+            }
+            return value;
+        }
+
+        // Every operand is evaluated, so that all dependencies are seen
+        // when exploring
+        template<typename Lookup>
+        CPLatticeValue out_value(size_t id, size_t var, Lookup &in) {
+            auto inst = cfg->get_node(id);
+            const auto &name = var_names[var];
+
+            if (inst == Assign) {
+                auto expr = (inst / Rhs) / Expr;
+                bool is_target = get_identifier(inst / Ident) == name;
+
+                if (expr == FunCall) {
+                    if (!is_target) {
+                        // Other variables keep their value from the call site
+                        return call_value(expr, var, in);
+                    }
+
+                    // Join result of all return statements
+                    auto value = CPLatticeValue::bottom();
+                    for (size_t pred : cfg->predecessor_ids(id)) {
+                        auto prev = cfg->get_node(pred);
+                        if (prev == Return) {
+                            value = value.join(atom_value(pred, prev / Atom, in));
+                        }
+                    }
+                    return value;
+                } else if (!is_target) {
+                    return in(id, var);
+                } else if (expr == Atom) {
+                    return atom_value(id, expr, in);
+                }
+
+                auto lhs = atom_value(id, expr / Lhs, in);
+                auto rhs = atom_value(id, expr / Rhs, in);
+
+                if (lhs.type == CPAbstractType::Constant &&
+                    rhs.type == CPAbstractType::Constant) {
+                    return CPLatticeValue::constant(
+                        apply_arith_op(expr, *lhs.value, *rhs.value));
+                } else if (
+                    lhs.type == CPAbstractType::Bottom ||
+                    rhs.type == CPAbstractType::Bottom) {
+                    return CPLatticeValue::bottom();
+                }
+                return CPLatticeValue::top();
+            } else if (inst == FunCall) {
+                return call_value(inst, var, in);
+            } else if (
+                inst == FunDef &&
+                get_identifier((inst / FunId) / Ident) != "main") {
+                // Only the parameters are defined when entering a function
+                for (const auto &param : *(inst / ParamList)) {
+                    if (get_identifier(param / Ident) == name) {
+                        return in(id, var);
+                    }
+                }
+                return CPLatticeValue::bottom();
+            }
+            return in(id, var);
+        }
+
+        // The value of var after the arguments are bound to the parameters
+        template<typename Lookup>
+        CPLatticeValue call_value(const Node &fun_call, size_t var, Lookup &in) {
+            size_t id = cfg->get_id(fun_call);
+            auto fun_def = cfg->get_fun_def(fun_call);
+
+            if (fun_def) {
+                auto params = fun_def / ParamList;
+                auto args = fun_call / ArgList;
+
+                for (size_t i = 0; i < params->size(); i++) {
+                    if (get_identifier(params->at(i) / Ident) ==
+                        var_names[var]) {
+                        return atom_value(id, args->at(i) / Atom, in);
+                    }
+                }
+            }
+            return in(id, var);
+        }
+
+        template<typename Lookup>
+        CPLatticeValue atom_value(size_t id, const Node &atom, Lookup &in) {
+            auto expr = atom / Expr;
+
+            if (expr == Int) {
+                return CPLatticeValue::constant(get_int_value(expr));
+            } else if (expr == Ident) {
+                auto var = var_ids.find(get_identifier(expr));
+                if (var != var_ids.end()) {
+                    return in(id, var->second);
+                }
+            }
+            return CPLatticeValue::top();
+        }
+    };
+}
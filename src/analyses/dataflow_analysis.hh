@@ -2,6 +2,8 @@
 #include "../control_flow.hh"
 #include "../internal.hh"
 
+#include <numeric>
+
 #define PRINT_WIDTH 15
 
 namespace whilelang {
@@ -13,16 +15,18 @@ namespace whilelang {
         State s1,
         State s2,
         const Vars &vars,
+        std::pmr::memory_resource *resource,
         const Node &node,
-        NodeMap<State> &stateTable,
+        std::pmr::map<Node, State> &stateTable,
         std::shared_ptr<ControlFlow> cfg) {
         typename Impl::StateTable;
 
-        requires std::same_as<typename Impl::StateTable, NodeMap<State>>;
+        requires std::
+            same_as<typename Impl::StateTable, std::pmr::map<Node, State>>;
 
-        // Creates a state which has not yet been reached.
-        // Typically maps all variables to bottom
-        { Impl::create_state(vars) } -> std::same_as<State>;
+        // Creates a state which has not yet been reached, allocated from the
+        // given resource. Typically maps all variables to bottom
+        { Impl::create_state(vars, resource) } -> std::same_as<State>;
 
         // Joins the two state and stores the result in the first one.
         // Returns a bool stating if the resulting state is changed
@@ -41,17 +45,24 @@ namespace whilelang {
     class DataFlowAnalysis {
       public:
         // Tracks a mapping from all program points to their corresponding state
-        using StateTable = NodeMap<State>;
+        using StateTable = std::pmr::map<Node, State>;
 
-        DataFlowAnalysis();
+        // The state table and all of its states are allocated from the arena
+        DataFlowAnalysis(std::shared_ptr<Arena> arena);
 
-        State get_state(const Node &instruction) {
+        State &get_state(const Node &instruction) {
             return state_table[instruction];
         };
 
         void forward_worklist_algoritm(
             std::shared_ptr<ControlFlow> cfg, State first_state);
 
+        // Context sensitive variant of the forward algorithm, where every
+        // function is analyzed once for each string of the last k calls
+        // leading to it. The resulting states are joined over all contexts.
+        void forward_call_string_algoritm(
+            std::shared_ptr<ControlFlow> cfg, State first_state, size_t k);
+
         void backward_worklist_algoritm(
             std::shared_ptr<ControlFlow> cfg, State first_state);
 
@@ -59,6 +70,9 @@ namespace whilelang {
         void log_state_table(std::shared_ptr<ControlFlow> cfg);
 
       private:
+        using CallString = std::vector<size_t>;
+
+        std::shared_ptr<Arena> arena;
         StateTable state_table;
 
         void init_state_table(
@@ -66,13 +80,15 @@ namespace whilelang {
             const Vars &vars,
             const Node &program_entry,
             State &first_state);
+
+        std::vector<State *> dense_states(std::shared_ptr<ControlFlow> cfg);
     };
 
     template<typename State, typename LatticeValue, typename Impl>
         requires DataflowImplementation<Impl, State>
-    DataFlowAnalysis<State, LatticeValue, Impl>::DataFlowAnalysis() {
-        this->state_table = StateTable();
-    }
+    DataFlowAnalysis<State, LatticeValue, Impl>::DataFlowAnalysis(
+        std::shared_ptr<Arena> arena)
+        : arena(arena), state_table(arena->resource()) {}
 
     template<typename State, typename LatticeValue, typename Impl>
         requires DataflowImplementation<Impl, State>
@@ -86,7 +102,8 @@ namespace whilelang {
         }
 
         for (const auto &inst : instructions) {
-            state_table.insert({inst, Impl::create_state(vars)});
+            state_table.try_emplace(
+                inst, Impl::create_state(vars, arena->resource()));
         }
 
         state_table[program_start] = first_state;
@@ -96,22 +113,24 @@ namespace whilelang {
         requires DataflowImplementation<Impl, State>
     void DataFlowAnalysis<State, LatticeValue, Impl>::forward_worklist_algoritm(
         std::shared_ptr<ControlFlow> cfg, State first_state) {
-        const auto instructions = cfg->get_instructions();
+        const auto &instructions = cfg->get_instructions();
         const Vars vars = cfg->get_vars();
 
-        std::deque<Node> worklist{cfg->get_program_entry()};
         this->init_state_table(
             instructions, vars, cfg->get_program_entry(), first_state);
+        auto states = this->dense_states(cfg);
+
+        std::deque<size_t> worklist{cfg->get_id(cfg->get_program_entry())};
 
         while (!worklist.empty()) {
-            Node inst = worklist.front();
+            size_t id = worklist.front();
             worklist.pop_front();
 
-            State out_state = Impl::flow(inst, state_table, cfg);
-            state_table[inst] = out_state;
+            State out_state = Impl::flow(cfg->get_node(id), state_table, cfg);
+            *states[id] = out_state;
 
-            for (Node succ : cfg->successors(inst)) {
-                bool changed = Impl::state_join(state_table[succ], out_state);
+            for (size_t succ : cfg->successor_ids(id)) {
+                bool changed = Impl::state_join(*states[succ], out_state);
 
                 if (changed) {
                     worklist.push_back(succ);
@@ -120,27 +139,166 @@ namespace whilelang {
         }
     }
 
+    // Each context has its own state table holding the instructions of its
+    // function and their predecessors, which includes the returns of the
+    // functions it calls. Calls extend the call string of the caller and
+    // drop the oldest call beyond k, so there are at most calls^k contexts.
+    // Returns only flow to the callers which entered the same context.
+    // The tables of the contexts are freed once the states are joined.
+    template<typename State, typename LatticeValue, typename Impl>
+        requires DataflowImplementation<Impl, State>
+    void
+    DataFlowAnalysis<State, LatticeValue, Impl>::forward_call_string_algoritm(
+        std::shared_ptr<ControlFlow> cfg, State first_state, size_t k) {
+        if (k == 0) {
+            forward_worklist_algoritm(cfg, first_state);
+            return;
+        }
+
+        const auto &instructions = cfg->get_instructions();
+        const Vars vars = cfg->get_vars();
+        const size_t size = cfg->nodes_size();
+
+        this->init_state_table(
+            instructions, vars, cfg->get_program_entry(), first_state);
+
+        NodeMap<std::vector<size_t>> scopes;
+        for (size_t id = 0; id < size; id++) {
+            auto fun_def = cfg->get_node(id);
+            while (fun_def != FunDef) {
+                fun_def = fun_def->parent();
+            }
+
+            auto &scope = scopes[fun_def];
+            scope.push_back(id);
+            for (size_t pred : cfg->predecessor_ids(id)) {
+                scope.push_back(pred);
+            }
+        }
+
+        auto resource = std::pmr::new_delete_resource();
+        std::map<CallString, size_t> context_ids;
+        std::vector<CallString> strings;
+        std::deque<StateTable> tables;
+        std::vector<std::vector<State *>> states;
+
+        auto context = [&](CallString string, const Node &fun_def) {
+            auto [res, inserted] =
+                context_ids.try_emplace(string, tables.size());
+
+            if (inserted) {
+                auto &table = tables.emplace_back(resource);
+                auto &dense = states.emplace_back(size, nullptr);
+
+                for (size_t id : scopes[fun_def]) {
+                    dense[id] = &table
+                                     .try_emplace(
+                                         cfg->get_node(id),
+                                         Impl::create_state(vars, resource))
+                                     .first->second;
+                }
+                strings.push_back(std::move(string));
+            }
+            return res->second;
+        };
+
+        // The contexts of the callers of each context, per call
+        std::map<std::pair<size_t, size_t>, std::set<size_t>> callers;
+
+        size_t entry = cfg->get_id(cfg->get_program_entry());
+        size_t root = context({}, cfg->get_node(entry));
+        *states[root][entry] = first_state;
+
+        std::deque<std::pair<size_t, size_t>> worklist{{root, entry}};
+
+        while (!worklist.empty()) {
+            auto [ctx, id] = worklist.front();
+            worklist.pop_front();
+
+            const auto &node = cfg->get_node(id);
+            State out_state = Impl::flow(node, tables[ctx], cfg);
+            *states[ctx][id] = out_state;
+
+            for (size_t succ : cfg->successor_ids(id)) {
+                const auto &succ_node = cfg->get_node(succ);
+
+                if (node == FunCall) {
+                    CallString string = strings[ctx];
+                    string.push_back(id);
+                    if (string.size() > k) {
+                        string.erase(string.begin());
+                    }
+
+                    size_t callee = context(string, succ_node);
+                    if (Impl::state_join(*states[callee][succ], out_state)) {
+                        worklist.push_back({callee, succ});
+                    }
+
+                    // A new caller also receives the returns already
+                    // reached in the context
+                    if (callers[{callee, id}].insert(ctx).second) {
+                        size_t site = cfg->get_id(node->parent()->parent());
+
+                        for (size_t pred : cfg->predecessor_ids(site)) {
+                            if (cfg->get_node(pred) == Return) {
+                                Impl::state_join(
+                                    *states[ctx][pred], *states[callee][pred]);
+                            }
+                        }
+                        worklist.push_back({ctx, site});
+                    }
+                } else if (node == Return && succ_node == Assign) {
+                    size_t call = cfg->get_id((succ_node / Rhs) / Expr);
+                    auto res = callers.find({ctx, call});
+                    if (res == callers.end()) {
+                        continue;
+                    }
+
+                    for (size_t caller : res->second) {
+                        if (Impl::state_join(*states[caller][id], out_state)) {
+                            worklist.push_back({caller, succ});
+                        }
+                    }
+                } else if (Impl::state_join(*states[ctx][succ], out_state)) {
+                    worklist.push_back({ctx, succ});
+                }
+            }
+        }
+
+        for (const auto &table : tables) {
+            for (const auto &[inst, state] : table) {
+                Impl::state_join(state_table[inst], state);
+            }
+        }
+
+        logging::Debug() << "Call strings of length " << k << " gave "
+                         << tables.size() << " contexts";
+    }
+
     template<typename State, typename LatticeValue, typename Impl>
         requires DataflowImplementation<Impl, State>
     void
     DataFlowAnalysis<State, LatticeValue, Impl>::backward_worklist_algoritm(
         std::shared_ptr<ControlFlow> cfg, State first_state) {
-        const auto instructions = cfg->get_instructions();
+        const auto &instructions = cfg->get_instructions();
         const Vars vars = cfg->get_vars();
 
-        std::deque<Node> worklist{instructions.begin(), instructions.end()};
         this->init_state_table(
             instructions, vars, cfg->get_program_exit(), first_state);
+        auto states = this->dense_states(cfg);
+
+        // Instructions have the ids 0..n-1
+        std::deque<size_t> worklist(instructions.size());
+        std::iota(worklist.begin(), worklist.end(), 0);
 
         while (!worklist.empty()) {
-            Node inst = worklist.front();
+            size_t id = worklist.front();
             worklist.pop_front();
 
-            State in_state = Impl::flow(inst, state_table, cfg);
+            State in_state = Impl::flow(cfg->get_node(id), state_table, cfg);
 
-            for (Node pred : cfg->predecessors(inst)) {
-                State &succ_state = state_table[pred];
-                bool changed = Impl::state_join(succ_state, in_state);
+            for (size_t pred : cfg->predecessor_ids(id)) {
+                bool changed = Impl::state_join(*states[pred], in_state);
 
                 if (changed) {
                     worklist.push_back(pred);
@@ -149,6 +307,22 @@ namespace whilelang {
         }
     }
 
+    // Maps the dense node ids of the control flow graph to their entries in
+    // the state table. Entries of a std::map are never moved, so the
+    // pointers stay valid while the solver runs.
+    template<typename State, typename LatticeValue, typename Impl>
+        requires DataflowImplementation<Impl, State>
+    std::vector<State *>
+    DataFlowAnalysis<State, LatticeValue, Impl>::dense_states(
+        std::shared_ptr<ControlFlow> cfg) {
+        std::vector<State *> states(cfg->nodes_size());
+
+        for (size_t id = 0; id < states.size(); id++) {
+            states[id] = &state_table[cfg->get_node(id)];
+        }
+        return states;
+    }
+
     // Requires the user to define the << operator for the State type
     template<typename State, typename LatticeValue, typename Impl>
         requires DataflowImplementation<Impl, State>
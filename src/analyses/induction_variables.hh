@@ -0,0 +1,155 @@
+#pragma once
+#include "../control_flow.hh"
+#include "../utils.hh"
+
+namespace whilelang {
+    using namespace trieste;
+
+    // A basic induction variable i of a loop is only assigned by a single
+    // update i := i + step (or step + i, i - c) in the loop, including its
+    // nested loops
+    struct BasicInduction {
+        Node update;
+        int step;
+    };
+
+    // An assignment j := i * factor (or factor * i) in a loop where i is a
+    // basic induction variable of the loop, so that j increases by
+    // step * factor in every update of i
+    struct DerivedInduction {
+        Node loop;
+        std::string base;
+        int factor;
+    };
+
+    class InductionVariables {
+      public:
+        InductionVariables(std::shared_ptr<ControlFlow> cfg) : cfg(cfg) {}
+
+        // Finds the induction variables of every loop of the program
+        void compute() {
+            basic.clear();
+            derived.clear();
+
+            for (const auto &loop : cfg->get_loops()) {
+                find_basic(loop);
+            }
+
+            for (const auto &loop : cfg->get_loops()) {
+                for (const auto &inst : cfg->get_loop_instructions(loop)) {
+                    if (cfg->get_loop(inst) == loop) {
+                        find_derived(inst);
+                    }
+                }
+            }
+        }
+
+        inline const std::map<std::string, BasicInduction> &
+        get_basic(const Node &loop) {
+            return basic[loop];
+        }
+
+        inline const NodeMap<DerivedInduction> &get_derived() {
+            return derived;
+        }
+
+      private:
+        std::shared_ptr<ControlFlow> cfg;
+        NodeMap<std::map<std::string, BasicInduction>> basic;
+        NodeMap<DerivedInduction> derived;
+
+        void find_basic(const Node &loop) {
+            // The body is walked rather than the loop instructions, in
+            // which an assignment of a call result appears as its call
+            std::map<std::string, Nodes> assigns;
+            gather_assigns(loop / Do, assigns);
+
+            // The variable must be defined when the loop is entered, which
+            // holds if the condition of the loop reads it
+            Vars cond_vars;
+            gather_atom_vars(loop / BExpr, cond_vars);
+
+            auto &loop_basic = basic[loop];
+            for (const auto &[var, defs] : assigns) {
+                if (defs.size() != 1 || !cond_vars.contains(var)) {
+                    continue;
+                }
+
+                if (auto step = update_step(defs.front(), var)) {
+                    loop_basic.insert({var, {defs.front(), *step}});
+                }
+            }
+        }
+
+        // The innermost loop containing the assignment in which the
+        // multiplied variable is a basic induction variable
+        void find_derived(const Node &inst) {
+            if (inst != Assign) {
+                return;
+            }
+
+            auto expr = (inst / Rhs) / Expr;
+            if (expr != Mul) {
+                return;
+            }
+
+            auto lhs = (expr / Lhs) / Expr;
+            auto rhs = (expr / Rhs) / Expr;
+            if (lhs == Int) {
+                std::swap(lhs, rhs);
+            }
+            if (lhs != Ident || rhs != Int) {
+                return;
+            }
+
+            auto var = get_identifier(lhs);
+            for (auto loop = cfg->get_loop(inst); loop;
+                 loop = cfg->get_parent_loop(loop)) {
+                if (basic[loop].contains(var)) {
+                    derived.insert({inst, {loop, var, get_int_value(rhs)}});
+                    return;
+                }
+            }
+        }
+
+        std::optional<int>
+        update_step(const Node &assign, const std::string &var) {
+            auto expr = (assign / Rhs) / Expr;
+            if (!expr->type().in({Add, Sub})) {
+                return std::nullopt;
+            }
+
+            auto lhs = (expr / Lhs) / Expr;
+            auto rhs = (expr / Rhs) / Expr;
+            if (expr == Add && lhs == Int) {
+                std::swap(lhs, rhs);
+            }
+
+            if (lhs != Ident || get_identifier(lhs) != var || rhs != Int) {
+                return std::nullopt;
+            }
+            return expr == Add ? get_int_value(rhs) : -get_int_value(rhs);
+        }
+
+        void
+        gather_assigns(const Node &n, std::map<std::string, Nodes> &assigns) {
+            if (n == Assign) {
+                assigns[get_identifier(n / Ident)].push_back(n);
+            }
+
+            for (const auto &child : *n) {
+                gather_assigns(child, assigns);
+            }
+        }
+
+        void gather_atom_vars(const Node &n, Vars &vars) {
+            if (n == Atom && n / Expr == Ident) {
+                vars.insert(get_identifier(n / Expr));
+            }
+
+            for (const auto &child : *n) {
+                gather_atom_vars(child, vars);
+            }
+        }
+    };
+}
@@ -0,0 +1,86 @@
+#pragma once
+#include "../call_graph.hh"
+#include "../utils.hh"
+
+namespace whilelang {
+    using namespace trieste;
+
+    // Finds the code whose execution may read input, either directly or
+    // through the functions it calls. Functions are summarized per strongly
+    // connected component of the call graph, callees before their callers.
+    // Variables depending on input are tracked by the partial evaluator,
+    // which only knows the values of variables computed without input.
+    class InputDependence {
+      public:
+        void compute(const Node &top) {
+            NodeSet fun_defs;
+            NodeSet fun_calls;
+            gather_functions(top, fun_defs, fun_calls);
+
+            CallGraph call_graph;
+            call_graph.build(fun_defs, fun_calls);
+
+            input_functions.clear();
+            known_functions.clear();
+            for (const auto &fun_def : fun_defs) {
+                known_functions.insert(function_name(fun_def));
+            }
+
+            for (const auto &scc : call_graph.get_sccs()) {
+                bool reads = false;
+                for (const auto &fun_def : scc) {
+                    reads = reads || reads_input(fun_def / Body);
+                }
+
+                if (reads) {
+                    for (const auto &fun_def : scc) {
+                        input_functions.insert(function_name(fun_def));
+                    }
+                }
+            }
+        }
+
+        // Calls of functions in the same component as the node are seen as
+        // not reading input until the whole component is summarized
+        bool reads_input(const Node &n) const {
+            if (n == Input) {
+                return true;
+            } else if (n == FunCall) {
+                auto name = get_identifier((n / FunId) / Ident);
+
+                if (!known_functions.contains(name) ||
+                    input_functions.contains(name)) {
+                    return true;
+                }
+            }
+
+            for (const auto &child : *n) {
+                if (reads_input(child)) {
+                    return true;
+                }
+            }
+            return false;
+        }
+
+      private:
+        std::set<std::string> known_functions;
+        std::set<std::string> input_functions;
+
+        std::string function_name(const Node &fun_def) const {
+            return get_identifier((fun_def / FunId) / Ident);
+        }
+
+        void gather_functions(
+            const Node &n, NodeSet &fun_defs, NodeSet &fun_calls) {
+            if (n == FunDef) {
+                fun_defs.insert(n);
+            } else if (n == FunCall) {
+                fun_calls.insert(n);
+            }
+
+            for (const auto &child : *n) {
+                gather_functions(child, fun_defs, fun_calls);
+            }
+        }
+    };
+}
@@ -3,16 +3,16 @@
 #include "dataflow_analysis.hh"
 
 namespace whilelang {
-    using LiveState = Vars;
+    using LiveState = std::pmr::set<std::string>;
 
-    Vars get_atom_defs(const Node &atom) {
+    inline Vars get_atom_defs(const Node &atom) {
         if (atom / Expr == Ident) {
             return {get_identifier(atom / Expr)};
         }
         return {};
     }
 
-    Vars get_aexpr_op_defs(const Node &op) {
+    inline Vars get_aexpr_op_defs(const Node &op) {
         auto lhs = get_atom_defs(op / Lhs);
         auto rhs = get_atom_defs(op / Rhs);
         lhs.insert(rhs.begin(), rhs.end());
@@ -20,7 +20,7 @@ namespace whilelang {
         return lhs;
     }
 
-    Vars get_aexpr_defs(const Node &inst) {
+    inline Vars get_aexpr_defs(const Node &inst) {
         if (inst == Atom) {
             return get_atom_defs(inst);
         } else if (inst->type().in({Add, Sub, Mul})) {
@@ -45,10 +45,11 @@ namespace whilelang {
     }
 
     struct LiveImpl {
-		using StateTable = NodeMap<LiveState>;
+		using StateTable = std::pmr::map<Node, LiveState>;
 
-        static LiveState create_state(Vars) {
-            return {};
+        static LiveState
+        create_state(const Vars &, std::pmr::memory_resource *resource) {
+            return LiveState(resource);
         }
 
         static bool state_join(LiveState &s1, const LiveState &s2) {
@@ -58,11 +59,12 @@ namespace whilelang {
             return changed;
         }
 
-        static Vars flow(
+        static LiveState flow(
             const Node &inst,
             StateTable &state_table,
             std::shared_ptr<ControlFlow>) {
-            Vars new_defs = state_table[inst];
+            const auto &state = state_table[inst];
+            LiveState new_defs(state, state.get_allocator());
             Vars gen_defs = {};
 
             if (inst == Assign) {
@@ -87,7 +89,7 @@ namespace whilelang {
         };
     };
 
-    std::ostream &operator<<(std::ostream &os, const LiveState &state) {
+    inline std::ostream &operator<<(std::ostream &os, const LiveState &state) {
         os << "{ ";
         for (const auto &var : state) {
             os << var << " ";
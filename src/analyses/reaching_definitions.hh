@@ -0,0 +1,93 @@
+#pragma once
+#include "../utils.hh"
+#include "dataflow_analysis.hh"
+
+namespace whilelang {
+    using namespace trieste;
+
+    // Maps every variable to the instructions whose definition of it may
+    // reach a program point. Parameters are defined by the calls binding
+    // them, variables without definitions come from outside the program.
+    using RDState = std::pmr::map<std::string, std::pmr::set<Node>>;
+
+    struct RDImpl {
+        using StateTable = std::pmr::map<Node, RDState>;
+
+        static RDState
+        create_state(const Vars &vars, std::pmr::memory_resource *resource) {
+            RDState state(resource);
+
+            for (const auto &var : vars) {
+                state[var];
+            }
+            return state;
+        }
+
+        static bool state_join(RDState &x, const RDState &y) {
+            bool changed = false;
+
+            auto it1 = x.begin();
+            auto it2 = y.begin();
+
+            while (it1 != x.end() && it2 != y.end()) {
+                for (const auto &def : it2->second) {
+                    changed |= it1->second.insert(def).second;
+                }
+                it1++;
+                it2++;
+            }
+
+            return changed;
+        }
+
+        static RDState flow(
+            const Node &inst,
+            StateTable &state_table,
+            std::shared_ptr<ControlFlow> cfg) {
+            const auto &state = state_table[inst];
+            RDState incoming_state(state, state.get_allocator());
+
+            if (inst == Assign) {
+                auto var = get_identifier(inst / Ident);
+                auto expr = (inst / Rhs) / Expr;
+
+                if (expr == FunCall) {
+                    // The other variables keep their definitions from the
+                    // call site
+                    RDState post_call_state(
+                        state_table[expr], state.get_allocator());
+                    post_call_state[var].clear();
+                    post_call_state[var].insert(inst);
+                    return post_call_state;
+                }
+
+                incoming_state[var].clear();
+                incoming_state[var].insert(inst);
+            } else if (inst == FunCall) {
+                auto fun_def = cfg->get_fun_def(inst);
+
+                if (fun_def) {
+                    for (const auto &param : *(fun_def / ParamList)) {
+                        auto var = get_identifier(param / Ident);
+                        incoming_state[var].clear();
+                        incoming_state[var].insert(inst);
+                    }
+                }
+            } else if (
+                inst == FunDef &&
+                get_identifier((inst / FunId) / Ident) != "main") {
+                auto param_vars = Vars();
+                for (const auto &param : *(inst / ParamList)) {
+                    param_vars.insert(get_identifier(param / Ident));
+                }
+
+                for (auto &[var, defs] : incoming_state) {
+                    if (!param_vars.contains(var)) {
+                        defs.clear();
+                    }
+                }
+            }
+            return incoming_state;
+        }
+    };
+}
@@ -0,0 +1,79 @@
+#pragma once
+#include "../call_graph.hh"
+#include "../utils.hh"
+
+namespace whilelang {
+    using namespace trieste;
+
+    struct FunctionEffects {
+        bool reads_input = false;
+        bool writes_output = false;
+
+        // Calling a pure function only computes its return value, so an
+        // unused call can be removed
+        inline bool is_pure() const {
+            return !reads_input && !writes_output;
+        }
+
+        inline void join(const FunctionEffects &other) {
+            reads_input = reads_input || other.reads_input;
+            writes_output = writes_output || other.writes_output;
+        }
+    };
+
+    // Summarizes the effects of every function, including the effects of
+    // the functions it calls. The functions of a strongly connected
+    // component of the call graph share one summary, and components are
+    // summarized with callees before their callers.
+    class SideEffects {
+      public:
+        void compute(CallGraph &call_graph) {
+            effects.clear();
+
+            for (const auto &scc : call_graph.get_sccs()) {
+                FunctionEffects scc_effects;
+
+                for (const auto &fun_def : scc) {
+                    local_effects(fun_def / Body, scc_effects);
+
+                    for (const auto &callee : call_graph.callees(fun_def)) {
+                        auto res = effects.find(callee);
+                        if (res != effects.end()) {
+                            scc_effects.join(res->second);
+                        }
+                    }
+                }
+
+                for (const auto &fun_def : scc) {
+                    effects[fun_def] = scc_effects;
+                }
+            }
+        }
+
+        // Functions without a summary are assumed to have every effect
+        inline FunctionEffects get(const Node &fun_def) const {
+            auto res = effects.find(fun_def);
+            return res != effects.end() ? res->second
+                                        : FunctionEffects{true, true};
+        }
+
+        inline bool is_pure(const Node &fun_def) const {
+            return get(fun_def).is_pure();
+        }
+
+      private:
+        NodeMap<FunctionEffects> effects;
+
+        void local_effects(const Node &n, FunctionEffects &effects) {
+            if (n == Input) {
+                effects.reads_input = true;
+            } else if (n == Output) {
+                effects.writes_output = true;
+            }
+
+            for (const auto &child : *n) {
+                local_effects(child, effects);
+            }
+        }
+    };
+}
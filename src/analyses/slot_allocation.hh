@@ -0,0 +1,145 @@
+#pragma once
+#include "../utils.hh"
+#include "dataflow_analysis.hh"
+#include "liveness.hh"
+
+namespace whilelang {
+    using namespace trieste;
+
+    using LiveAnalysis = DataFlowAnalysis<LiveState, std::string, LiveImpl>;
+
+    // Assigns every variable a slot in the frame of its function, where
+    // variables which are never live at the same time share a slot. Two
+    // variables interfere when one is assigned while the other is live
+    // after the assignment, except for the source of a copy. The parameters
+    // interfere with each other, as they are all assigned on entry. The
+    // interference graph of each function is colored greedily in the order
+    // the variables first occur.
+    class SlotAllocation {
+      public:
+        void compute(std::shared_ptr<ControlFlow> cfg, LiveAnalysis &liveness) {
+            slots.clear();
+            frame_sizes.clear();
+
+            NodeMap<Nodes> fun_instructions;
+            for (size_t id = 0; id < cfg->nodes_size(); id++) {
+                auto inst = cfg->get_node(id);
+                auto fun_def = inst;
+                while (fun_def != FunDef) {
+                    fun_def = fun_def->parent();
+                }
+                fun_instructions[fun_def].push_back(inst);
+            }
+
+            for (const auto &[fun_def, instructions] : fun_instructions) {
+                allocate(fun_def, instructions, liveness);
+            }
+        }
+
+        inline std::optional<size_t> get_slot(const std::string &var) const {
+            auto res = slots.find(var);
+            return res != slots.end() ? std::optional(res->second)
+                                      : std::nullopt;
+        }
+
+        inline const std::map<std::string, size_t> &get_slots() const {
+            return slots;
+        }
+
+        // Number of slots needed by the frame of the function
+        inline size_t frame_size(const Node &fun_def) const {
+            auto res = frame_sizes.find(fun_def);
+            return res != frame_sizes.end() ? res->second : 0;
+        }
+
+      private:
+        using Interference = std::map<std::string, Vars>;
+
+        std::map<std::string, size_t> slots;
+        NodeMap<size_t> frame_sizes;
+
+        void allocate(
+            const Node &fun_def,
+            const Nodes &instructions,
+            LiveAnalysis &liveness) {
+            std::vector<std::string> order;
+            Vars vars;
+            gather_vars(fun_def, order, vars);
+
+            Interference interference;
+            auto interfere = [&](const std::string &a, const std::string &b) {
+                if (a != b && vars.contains(a) && vars.contains(b)) {
+                    interference[a].insert(b);
+                    interference[b].insert(a);
+                }
+            };
+
+            auto params = fun_def / ParamList;
+            for (const auto &param : *params) {
+                auto var = get_identifier(param / Ident);
+
+                for (const auto &other : *params) {
+                    interfere(var, get_identifier(other / Ident));
+                }
+                for (const auto &live : liveness.get_state(fun_def)) {
+                    interfere(var, live);
+                }
+            }
+
+            for (const auto &inst : instructions) {
+                if (inst != Assign) {
+                    continue;
+                }
+
+                auto var = get_identifier(inst / Ident);
+                auto expr = (inst / Rhs) / Expr;
+                std::optional<std::string> source;
+                if (expr == Atom && expr / Expr == Ident) {
+                    source = get_identifier(expr / Expr);
+                }
+
+                for (const auto &live : liveness.get_state(inst)) {
+                    if (live != source) {
+                        interfere(var, live);
+                    }
+                }
+            }
+
+            size_t size = 0;
+            for (const auto &var : order) {
+                std::set<size_t> used;
+                for (const auto &other : interference[var]) {
+                    auto res = slots.find(other);
+                    if (res != slots.end()) {
+                        used.insert(res->second);
+                    }
+                }
+
+                size_t slot = 0;
+                while (used.contains(slot)) {
+                    slot++;
+                }
+
+                slots[var] = slot;
+                size = std::max(size, slot + 1);
+            }
+            frame_sizes[fun_def] = size;
+        }
+
+        // Variables of the function in the order they first occur, starting
+        // with the parameters
+        void gather_vars(
+            const Node &n, std::vector<std::string> &order, Vars &vars) {
+            if (n == Ident && n->parent() != FunId) {
+                auto var = get_identifier(n);
+                if (vars.insert(var).second) {
+                    order.push_back(var);
+                }
+            }
+
+            for (const auto &child : *n) {
+                gather_vars(child, order, vars);
+            }
+        }
+    };
+}
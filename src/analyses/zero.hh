@@ -4,7 +4,15 @@
 
 namespace whilelang {
 
-    enum class ZeroAbstractType { Bottom, Zero, NonZero, Top };
+    // The sign of a value when it is known, otherwise only whether it is zero
+    enum class ZeroAbstractType {
+        Bottom,
+        Zero,
+        Positive,
+        Negative,
+        NonZero,
+        Top
+    };
 
     struct ZeroLatticeValue {
         ZeroAbstractType type;
@@ -15,7 +23,6 @@ namespace whilelang {
 
         ZeroLatticeValue join(const ZeroLatticeValue &other) const {
             auto top = ZeroLatticeValue::top();
-            auto zero = ZeroLatticeValue::zero();
             auto non_zero = ZeroLatticeValue::non_zero();
             auto bottom = ZeroLatticeValue::bottom();
 
@@ -23,15 +30,35 @@ namespace whilelang {
                 return other;
             } else if (other == bottom) {
                 return *this;
-            } else if (*this == zero && other == zero) {
-                return zero;
-            } else if (*this == non_zero && other == non_zero) {
+            } else if (*this == other) {
+                return *this;
+            } else if (this->is_non_zero() && other.is_non_zero()) {
                 return non_zero;
             }
 
             return top;
         }
 
+        bool is_non_zero() const {
+            return type == ZeroAbstractType::Positive ||
+                type == ZeroAbstractType::Negative ||
+                type == ZeroAbstractType::NonZero;
+        }
+
+        // -1, 0 or 1 when the sign is known
+        std::optional<int> sign() const {
+            switch (type) {
+                case ZeroAbstractType::Zero:
+                    return 0;
+                case ZeroAbstractType::Positive:
+                    return 1;
+                case ZeroAbstractType::Negative:
+                    return -1;
+                default:
+                    return std::nullopt;
+            }
+        }
+
         friend std::ostream &
         operator<<(std::ostream &os, const ZeroLatticeValue &value) {
             switch (value.type) {
@@ -41,6 +68,12 @@ namespace whilelang {
                 case ZeroAbstractType::Zero:
                     os << "0";
                     break;
+                case ZeroAbstractType::Positive:
+                    os << "+";
+                    break;
+                case ZeroAbstractType::Negative:
+                    os << "-";
+                    break;
                 case ZeroAbstractType::NonZero:
                     os << "N";
                     break;
@@ -57,6 +90,12 @@ namespace whilelang {
         static ZeroLatticeValue zero() {
             return {ZeroAbstractType::Zero};
         }
+        static ZeroLatticeValue positive() {
+            return {ZeroAbstractType::Positive};
+        }
+        static ZeroLatticeValue negative() {
+            return {ZeroAbstractType::Negative};
+        }
         static ZeroLatticeValue non_zero() {
             return {ZeroAbstractType::NonZero};
         }
@@ -65,12 +104,18 @@ namespace whilelang {
         }
     };
 
-    using ZeroState = std::map<std::string, ZeroLatticeValue>;
+    using ZeroState = std::pmr::map<std::string, ZeroLatticeValue>;
 
-    ZeroLatticeValue handle_atom(const Node atom, ZeroState &incoming_state) {
+    inline ZeroLatticeValue
+    handle_atom(const Node atom, ZeroState &incoming_state) {
         if (atom == Int) {
-            return get_int_value(atom) == 0 ? ZeroLatticeValue::zero() :
-                                              ZeroLatticeValue::non_zero();
+            auto value = get_int_value(atom);
+
+            if (value == 0) {
+                return ZeroLatticeValue::zero();
+            }
+            return value > 0 ? ZeroLatticeValue::positive() :
+                               ZeroLatticeValue::negative();
         } else if (atom == Ident) {
             std::string rhs_var = get_identifier(atom);
             return incoming_state[rhs_var];
@@ -79,11 +124,65 @@ namespace whilelang {
         }
     };
 
+    // Only results which can not be changed by an overflow are derived, so
+    // the sign is kept through additions of zero but not of two positives
+    inline ZeroLatticeValue zero_arith_op(
+        const Node &op, ZeroLatticeValue lhs, ZeroLatticeValue rhs) {
+        auto zero = ZeroLatticeValue::zero();
+
+        if (lhs == ZeroLatticeValue::bottom() ||
+            rhs == ZeroLatticeValue::bottom()) {
+            return ZeroLatticeValue::bottom();
+        } else if (op == Mul && (lhs == zero || rhs == zero)) {
+            return zero;
+        } else if (op == Add && lhs == zero) {
+            return rhs;
+        } else if (op->type().in({Add, Sub}) && rhs == zero) {
+            return lhs;
+        } else if (op == Sub && lhs == zero) {
+            // Negating the smallest integer overflows, so a negative value
+            // only stays non zero
+            if (rhs == ZeroLatticeValue::positive()) {
+                return ZeroLatticeValue::negative();
+            }
+            return rhs.is_non_zero() ? ZeroLatticeValue::non_zero() :
+                                       ZeroLatticeValue::top();
+        }
+        return ZeroLatticeValue::top();
+    }
+
+    // The result of a comparison when the signs of the operands decide it
+    inline std::optional<bool> zero_compare(
+        const Node &op, ZeroLatticeValue lhs, ZeroLatticeValue rhs) {
+        auto lhs_sign = lhs.sign();
+        auto rhs_sign = rhs.sign();
+
+        if (op == Equals) {
+            if (lhs == ZeroLatticeValue::zero() &&
+                rhs == ZeroLatticeValue::zero()) {
+                return true;
+            } else if (
+                (lhs == ZeroLatticeValue::zero() && rhs.is_non_zero()) ||
+                (lhs.is_non_zero() && rhs == ZeroLatticeValue::zero()) ||
+                (lhs_sign && rhs_sign && *lhs_sign != *rhs_sign)) {
+                return false;
+            }
+        } else if (lhs_sign && rhs_sign) {
+            if (*lhs_sign != *rhs_sign) {
+                return *lhs_sign < *rhs_sign;
+            } else if (*lhs_sign == 0) {
+                return false;
+            }
+        }
+        return std::nullopt;
+    }
+
     struct ZeroImpl {
-		using StateTable = NodeMap<ZeroState>;
+		using StateTable = std::pmr::map<Node, ZeroState>;
 
-        static ZeroState create_state(const Vars &vars) {
-            ZeroState state = ZeroState();
+        static ZeroState
+        create_state(const Vars &vars, std::pmr::memory_resource *resource) {
+            ZeroState state(resource);
 
             for (auto var : vars) {
                 state[var] = ZeroLatticeValue::bottom();
@@ -119,7 +218,8 @@ namespace whilelang {
             const Node &inst,
             StateTable &state_table,
             std::shared_ptr<ControlFlow> cfg) {
-            auto incoming_state = state_table[inst];
+            const auto &state = state_table[inst];
+            ZeroState incoming_state(state, state.get_allocator());
             if (inst == Assign) {
                 auto var = get_identifier(inst / Ident);
                 Node rhs = (inst / Rhs) / Expr;
@@ -127,18 +227,24 @@ namespace whilelang {
                 if (rhs == Atom) {
                     auto atom = rhs / Expr;
                     incoming_state[var] = handle_atom(atom, incoming_state);
+                } else if (rhs->type().in({Add, Sub, Mul})) {
+                    incoming_state[var] = zero_arith_op(
+                        rhs,
+                        handle_atom((rhs / Lhs) / Expr, incoming_state),
+                        handle_atom((rhs / Rhs) / Expr, incoming_state));
                 } else if (rhs == FunCall) {
-                    auto prevs = cfg->predecessors(inst);
+                    const auto &prevs = cfg->predecessors(inst);
                     ZeroLatticeValue val = ZeroLatticeValue::bottom();
 
                     for (auto node : prevs) {
                         if (node == Return) {
                             val = val.join(handle_atom(
-                                (node / Atom) / Expr, incoming_state));
+                                (node / Atom) / Expr, state_table[node]));
                         }
                     }
 
-                    auto pre_fun_call_state = state_table[rhs];
+                    ZeroState pre_fun_call_state(
+                        state_table[rhs], state.get_allocator());
                     pre_fun_call_state[var] = val;
                     return pre_fun_call_state;
                 }
@@ -160,7 +266,8 @@ namespace whilelang {
         }
     };
 
-    std::ostream &operator<<(std::ostream &os, const ZeroState &state) {
+    inline std::ostream &
+    operator<<(std::ostream &os, const ZeroState &state) {
         for (const auto &[_, value] : state) {
             os << std::setw(PRINT_WIDTH) << value;
         }
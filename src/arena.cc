@@ -0,0 +1,30 @@
+#include "arena.hh"
+
+#include <sys/resource.h>
+
+namespace whilelang {
+
+    void *CountingResource::do_allocate(size_t bytes, size_t alignment) {
+        allocation_count.fetch_add(1, std::memory_order_relaxed);
+        return std::pmr::new_delete_resource()->allocate(bytes, alignment);
+    }
+
+    void CountingResource::do_deallocate(
+        void *p, size_t bytes, size_t alignment) {
+        std::pmr::new_delete_resource()->deallocate(p, bytes, alignment);
+    }
+
+    bool CountingResource::do_is_equal(
+        const std::pmr::memory_resource &other) const noexcept {
+        return dynamic_cast<const CountingResource *>(&other) != nullptr;
+    }
+
+    Arena::Arena(bool enabled)
+        : enabled(enabled), heap(), monotonic(&heap), pool(&monotonic) {}
+
+    long peak_rss_kb() {
+        struct rusage usage;
+        getrusage(RUSAGE_SELF, &usage);
+        return usage.ru_maxrss;
+    }
+}
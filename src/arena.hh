@@ -0,0 +1,49 @@
+#pragma once
+
+#include <atomic>
+#include <memory_resource>
+
+namespace whilelang {
+
+    // Forwards to the heap while counting every allocation that reaches it
+    class CountingResource : public std::pmr::memory_resource {
+      public:
+        static size_t allocations() {
+            return allocation_count.load(std::memory_order_relaxed);
+        }
+
+      private:
+        static inline std::atomic<size_t> allocation_count = 0;
+
+        void *do_allocate(size_t bytes, size_t alignment) override;
+        void do_deallocate(void *p, size_t bytes, size_t alignment) override;
+        bool do_is_equal(
+            const std::pmr::memory_resource &other) const noexcept override;
+    };
+
+    // Memory for the containers of one optimization round. Blocks come from
+    // a monotonic buffer and freed blocks are recycled by a pool, everything
+    // is returned to the heap in one go when the arena is destroyed.
+    // A disabled arena allocates every block directly from the heap.
+    class Arena {
+      public:
+        Arena(bool enabled = true);
+
+        Arena(const Arena &) = delete;
+        Arena &operator=(const Arena &) = delete;
+
+        inline std::pmr::memory_resource *resource() {
+            return enabled ? static_cast<std::pmr::memory_resource *>(&pool)
+                           : &heap;
+        };
+
+      private:
+        bool enabled;
+        CountingResource heap;
+        std::pmr::monotonic_buffer_resource monotonic;
+        std::pmr::unsynchronized_pool_resource pool;
+    };
+
+    // Resident set size high-water mark of the process in kilobytes
+    long peak_rss_kb();
+}
@@ -0,0 +1,138 @@
+#include "call_graph.hh"
+
+#include "utils.hh"
+
+namespace whilelang {
+    using namespace trieste;
+
+    // Public
+    CallGraph::CallGraph() {
+        this->fun_defs_by_name = std::unordered_map<std::string, Node>();
+        this->callee_map = NodeMap<NodeSet>();
+        this->reachable = NodeSet();
+        this->recursive = NodeSet();
+        this->sccs = std::vector<Nodes>();
+    }
+
+    void CallGraph::clear() {
+        fun_defs_by_name.clear();
+        callee_map.clear();
+        reachable.clear();
+        recursive.clear();
+        sccs.clear();
+    }
+
+    void CallGraph::build(const NodeSet &fun_defs, const NodeSet &fun_calls) {
+        clear();
+
+        for (const auto &fun_def : fun_defs) {
+            fun_defs_by_name.insert(
+                {get_identifier((fun_def / FunId) / Ident), fun_def});
+            callee_map.insert({fun_def, {}});
+        }
+
+        for (const auto &fun_call : fun_calls) {
+            auto callee = get_fun_def(get_identifier((fun_call / FunId) / Ident));
+            if (!callee) {
+                continue;
+            }
+
+            Node caller = fun_call;
+            while (caller != FunDef) {
+                caller = caller->parent();
+            }
+            callee_map[caller].insert(callee);
+        }
+
+        compute_sccs(fun_defs);
+        compute_reachable();
+    }
+
+    void CallGraph::log_call_graph() {
+        logging::Debug() << "Call graph: ";
+        for (const auto &scc : sccs) {
+            std::stringstream str_builder;
+            str_builder << "{ ";
+            for (const auto &fun_def : scc) {
+                str_builder << get_identifier((fun_def / FunId) / Ident)
+                            << (is_reachable(fun_def) ? " " : "(dead) ");
+            }
+            str_builder << "}";
+            logging::Debug() << str_builder.str();
+        }
+    }
+
+    // Private
+
+    // Tarjan's algorithm, components are emitted when their root is
+    // finished which gives them in reverse topological order
+    void CallGraph::compute_sccs(const NodeSet &fun_defs) {
+        NodeMap<size_t> index;
+        NodeMap<size_t> low_link;
+        NodeSet on_stack;
+        Nodes stack;
+        size_t next_index = 0;
+
+        std::function<void(const Node &)> connect = [&](const Node &fun_def) {
+            index[fun_def] = next_index;
+            low_link[fun_def] = next_index;
+            next_index++;
+            stack.push_back(fun_def);
+            on_stack.insert(fun_def);
+
+            for (const auto &callee : callee_map[fun_def]) {
+                if (!index.contains(callee)) {
+                    connect(callee);
+                    low_link[fun_def] =
+                        std::min(low_link[fun_def], low_link[callee]);
+                } else if (on_stack.contains(callee)) {
+                    low_link[fun_def] =
+                        std::min(low_link[fun_def], index[callee]);
+                }
+            }
+
+            if (low_link[fun_def] == index[fun_def]) {
+                Nodes scc;
+                Node member;
+                do {
+                    member = stack.back();
+                    stack.pop_back();
+                    on_stack.erase(member);
+                    scc.push_back(member);
+                } while (member != fun_def);
+
+                if (scc.size() > 1 || callee_map[fun_def].contains(fun_def)) {
+                    recursive.insert(scc.begin(), scc.end());
+                }
+                sccs.push_back(scc);
+            }
+        };
+
+        for (const auto &fun_def : fun_defs) {
+            if (!index.contains(fun_def)) {
+                connect(fun_def);
+            }
+        }
+    }
+
+    void CallGraph::compute_reachable() {
+        auto main = get_main();
+        if (!main) {
+            return;
+        }
+
+        Nodes worklist{main};
+        reachable.insert(main);
+
+        while (!worklist.empty()) {
+            auto fun_def = worklist.back();
+            worklist.pop_back();
+
+            for (const auto &callee : callee_map[fun_def]) {
+                if (reachable.insert(callee).second) {
+                    worklist.push_back(callee);
+                }
+            }
+        }
+    }
+}
@@ -0,0 +1,60 @@
+#pragma once
+#include "lang.hh"
+
+#include <unordered_map>
+
+namespace whilelang {
+    using namespace trieste;
+
+    class CallGraph {
+      public:
+        CallGraph();
+
+        void clear();
+
+        // Builds the graph from all function definitions and calls of the
+        // program, computing its strongly connected components and the
+        // functions reachable from main
+        void build(const NodeSet &fun_defs, const NodeSet &fun_calls);
+
+        // Returns the definition with the given name, or an empty node
+        inline Node get_fun_def(const std::string &name) const {
+            auto res = fun_defs_by_name.find(name);
+            return res != fun_defs_by_name.end() ? res->second : Node{};
+        };
+
+        inline Node get_main() const {
+            return get_fun_def("main");
+        };
+
+        inline const NodeSet &callees(const Node &fun_def) {
+            return callee_map[fun_def];
+        };
+
+        inline bool is_reachable(const Node &fun_def) const {
+            return reachable.contains(fun_def);
+        };
+
+        // Strongly connected components in reverse topological order,
+        // callees always come before their callers
+        inline const std::vector<Nodes> &get_sccs() const {
+            return sccs;
+        };
+
+        inline bool is_recursive(const Node &fun_def) const {
+            return recursive.contains(fun_def);
+        };
+
+        void log_call_graph();
+
+      private:
+        std::unordered_map<std::string, Node> fun_defs_by_name;
+        NodeMap<NodeSet> callee_map;
+        NodeSet reachable;
+        NodeSet recursive;
+        std::vector<Nodes> sccs;
+
+        void compute_sccs(const NodeSet &fun_defs);
+        void compute_reachable();
+    };
+}
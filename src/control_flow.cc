@@ -6,13 +6,21 @@ namespace whilelang {
     using namespace trieste;
 
     // Public
-    ControlFlow::ControlFlow() {
+    ControlFlow::ControlFlow(std::shared_ptr<Arena> arena)
+        : arena(arena),
+          predecessor(arena->resource()),
+          successor(arena->resource()),
+          nodes(arena->resource()),
+          node_ids(arena->resource()),
+          succ_offsets(arena->resource()),
+          succ_edges(arena->resource()),
+          pred_offsets(arena->resource()),
+          pred_edges(arena->resource()) {
         this->instructions = Nodes();
         this->vars = Vars();
-        this->predecessor = NodeMap<NodeSet>();
-        this->successor = NodeMap<NodeSet>();
         this->fun_call_to_def = NodeMap<Node>();
         this->fun_def_to_calls = NodeMap<NodeSet>();
+        this->call_graph = CallGraph();
         this->dirty_flag = false;
     }
 
@@ -23,6 +31,16 @@ namespace whilelang {
         successor.clear();
         fun_call_to_def.clear();
         fun_def_to_calls.clear();
+        call_graph.clear();
+        nodes.clear();
+        node_ids.clear();
+        succ_offsets.clear();
+        succ_edges.clear();
+        pred_offsets.clear();
+        pred_edges.clear();
+        loops.clear();
+        inst_loop.clear();
+        loop_instructions.clear();
     }
 
     void ControlFlow::add_var(Node ident) {
@@ -43,30 +61,51 @@ namespace whilelang {
         append_to_nodemap(predecessor, v, u);
     }
 
+    void ControlFlow::finalize() {
+        nodes.clear();
+        node_ids.clear();
+
+        for (const auto &inst : instructions) {
+            add_node_id(inst);
+        }
+
+        // Edges may end in nodes which are not instructions, such as the
+        // assignment of a function call result
+        for (const auto &[node, succs] : successor) {
+            add_node_id(node);
+            for (const auto &succ : succs) {
+                add_node_id(succ);
+            }
+        }
+
+        build_csr(successor, succ_offsets, succ_edges);
+        build_csr(predecessor, pred_offsets, pred_edges);
+        build_loops();
+    }
+
     // Fill the map with function calls to their definitions
     void ControlFlow::set_functions_calls(
         std::shared_ptr<NodeSet> fun_defs, std::shared_ptr<NodeSet> fun_calls) {
+        call_graph.build(*fun_defs, *fun_calls);
+
         for (auto fun_call : *fun_calls) {
             auto call_id_str = get_identifier((fun_call / FunId) / Ident);
+            auto fun_def = call_graph.get_fun_def(call_id_str);
 
-            for (auto fun_def : *fun_defs) {
-                auto fun_def_str = get_identifier((fun_def / FunId) / Ident);
-                if (call_id_str == fun_def_str) {
-                    append_to_nodemap(fun_def_to_calls, fun_def, fun_call);
-                    fun_call_to_def.insert({fun_call, fun_def});
-                }
+            if (fun_def) {
+                fun_def_to_calls[fun_def].insert(fun_call);
+                fun_call_to_def.insert({fun_call, fun_def});
             }
         }
 
-        for (auto fun_def : *fun_defs) {
-            if (get_identifier((fun_def / FunId) / Ident) == "main") {
-                this->program_entry = fun_def;
-                this->program_exit = get_last_basic_child(fun_def / Body);
-                return;
-            }
+        auto main = call_graph.get_main();
+        if (!main) {
+            throw std::runtime_error(
+                "No main function found. Please define a main function.");
         }
-        throw std::runtime_error(
-            "No main function found. Please define a main function.");
+
+        this->program_entry = main;
+        this->program_exit = get_last_basic_child(main / Body);
     }
 
     void ControlFlow::log_predecessors_and_successors() {
@@ -122,36 +161,94 @@ namespace whilelang {
                 logging::Debug() << call << "\n";
             }
         }
+        call_graph.log_call_graph();
     }
 
     // Private
 
-    void ControlFlow::append_to_nodemap(
-        NodeMap<NodeSet> &map, const Node &key, const Node &value) {
-        auto res = map.find(key);
-
-        if (res != map.end()) {
-            // Append to nodemap entry if already exist
-            res->second.insert(value);
-        } else {
-            // Otherwise create new entry
-            map.insert({key, {value}});
+    size_t ControlFlow::add_node_id(const Node &node) {
+        auto [it, inserted] = node_ids.insert({node, nodes.size()});
+
+        if (inserted) {
+            nodes.push_back(node);
         }
+        return it->second;
     }
 
-    void ControlFlow::append_to_nodemap(
-        NodeMap<NodeSet> &map, const Node &key, const NodeSet &values) {
-        auto res = map.find(key);
+    // Every instruction belongs to all While statements among its
+    // ancestors. Instructions are in program order, so a loop is always
+    // found through its condition before any instruction of its body.
+    void ControlFlow::build_loops() {
+        loops.clear();
+        inst_loop.clear();
+        loop_instructions.clear();
+
+        for (const auto &inst : instructions) {
+            Node inner;
+
+            for (Node curr = inst; curr != FunDef; curr = curr->parent()) {
+                auto loop = curr->parent();
+
+                if (loop == While) {
+                    if (!inner) {
+                        inner = loop;
+                    }
+                    if (!loop_instructions.contains(loop)) {
+                        loops.push_back(loop);
+                    }
+                    loop_instructions[loop].push_back(inst);
+                }
+            }
 
-        if (res != map.end()) {
-            res->second.insert(values.begin(), values.end());
-        } else {
-            map.insert({key, values});
+            if (inner) {
+                inst_loop.insert({inst, inner});
+            }
+        }
+
+        for (const auto &loop : loops) {
+            for (Node curr = loop->parent(); curr != FunDef;
+                 curr = curr->parent()) {
+                if (curr == While) {
+                    inst_loop.insert({loop, curr});
+                    break;
+                }
+            }
         }
     }
 
+    void ControlFlow::build_csr(
+        const EdgeMap &map,
+        std::pmr::vector<size_t> &offsets,
+        std::pmr::vector<size_t> &edges) {
+        offsets.assign(nodes.size() + 1, 0);
+        edges.clear();
+
+        for (size_t id = 0; id < nodes.size(); id++) {
+            auto res = map.find(nodes[id]);
+
+            if (res != map.end()) {
+                for (const auto &node : res->second) {
+                    edges.push_back(node_ids.at(node));
+                }
+            }
+            offsets[id + 1] = edges.size();
+        }
+    }
+
+    // Entries are created through operator[] so that the sets are
+    // constructed with the allocator of the map
+    void ControlFlow::append_to_nodemap(
+        EdgeMap &map, const Node &key, const Node &value) {
+        map[key].insert(value);
+    }
+
+    void ControlFlow::append_to_nodemap(
+        EdgeMap &map, const Node &key, const NodeSet &values) {
+        map[key].insert(values.begin(), values.end());
+    }
+
     void ControlFlow::append_to_nodemap(
-        NodeMap<NodeSet> &map, const NodeSet &nodes, const Node &value) {
+        EdgeMap &map, const NodeSet &nodes, const Node &value) {
         for (auto &node : nodes) {
             append_to_nodemap(map, node, value);
         }
@@ -1,29 +1,90 @@
 #pragma once
+#include "arena.hh"
+#include "call_graph.hh"
 #include "lang.hh"
 
+#include <span>
+
 namespace whilelang {
     using namespace trieste;
 
     using Vars = std::set<std::string>;
 
+    // Edge containers allocate from the arena of the control flow graph
+    using EdgeSet = std::pmr::set<Node>;
+    using EdgeMap = std::pmr::map<Node, EdgeSet>;
+
     class ControlFlow {
       public:
-        ControlFlow();
+        ControlFlow(std::shared_ptr<Arena> arena = std::make_shared<Arena>());
 
         void clear();
 
-        inline const NodeSet &successors(const Node &node) {
+        inline const EdgeSet &successors(const Node &node) {
             return successor[node];
         };
 
-        inline const NodeSet &predecessors(const Node &node) {
+        inline const EdgeSet &predecessors(const Node &node) {
             return predecessor[node];
         };
 
+        inline std::shared_ptr<Arena> get_arena() {
+            return arena;
+        };
+
         inline const Nodes &get_instructions() {
             return instructions;
         };
 
+        // Dense ids are only available after the graph has been finalized.
+        // The instructions have the ids 0..n-1 in order, followed by any
+        // other node that is the endpoint of an edge.
+        inline size_t get_id(const Node &node) {
+            return node_ids.at(node);
+        };
+
+        inline const Node &get_node(size_t id) {
+            return nodes[id];
+        };
+
+        inline size_t nodes_size() {
+            return nodes.size();
+        };
+
+        inline std::span<const size_t> successor_ids(size_t id) {
+            return {
+                succ_edges.data() + succ_offsets[id],
+                succ_offsets[id + 1] - succ_offsets[id]};
+        };
+
+        inline std::span<const size_t> predecessor_ids(size_t id) {
+            return {
+                pred_edges.data() + pred_offsets[id],
+                pred_offsets[id + 1] - pred_offsets[id]};
+        };
+
+        // All loops of the program, enclosing loops before the loops nested
+        // in them. Only available after the graph has been finalized.
+        inline const Nodes &get_loops() {
+            return loops;
+        };
+
+        // The innermost While whose condition or body contains the
+        // instruction, or an empty node if there is none
+        inline Node get_loop(const Node &inst) {
+            auto res = inst_loop.find(inst);
+            return res != inst_loop.end() ? res->second : Node{};
+        };
+
+        inline Node get_parent_loop(const Node &loop) {
+            return get_loop(loop);
+        };
+
+        // Instructions of the loop, including those of nested loops
+        inline const Nodes &get_loop_instructions(const Node &loop) {
+            return loop_instructions[loop];
+        };
+
         inline const Vars &get_vars() {
             return vars;
         };
@@ -48,6 +109,10 @@ namespace whilelang {
             return fun_def_to_calls[fun_def];
         };
 
+        inline CallGraph &get_call_graph() {
+            return call_graph;
+        };
+
         inline Node get_program_entry() {
             return program_entry;
         };
@@ -66,12 +131,18 @@ namespace whilelang {
         void add_edge(const Node &u, const NodeSet &v);
         void add_edge(const NodeSet &u, const Node &v);
 
+        // Builds the compressed sparse row adjacency of the graph, must be
+        // called once all edges have been added
+        void finalize();
+
         void log_predecessors_and_successors();
         void log_instructions();
         void log_variables();
         void log_functions();
 
       private:
+        // Declared first so that it outlives every container using it
+        std::shared_ptr<Arena> arena;
         Node program_entry;
         Node program_exit;
         Nodes instructions;
@@ -79,14 +150,35 @@ namespace whilelang {
         bool dirty_flag;
         NodeMap<Node> fun_call_to_def; // Maps fun calls to their declarations
         NodeMap<NodeSet> fun_def_to_calls; // Maps fun defs to their call sites
-        NodeMap<NodeSet> predecessor;
-        NodeMap<NodeSet> successor;
+        CallGraph call_graph;
+        EdgeMap predecessor;
+        EdgeMap successor;
+
+        // Loop structure, a While maps to its enclosing loop in inst_loop
+        Nodes loops;
+        NodeMap<Node> inst_loop;
+        NodeMap<Nodes> loop_instructions;
+
+        // Compressed sparse row representation of the edges over dense ids
+        std::pmr::vector<Node> nodes;
+        std::pmr::map<Node, size_t> node_ids;
+        std::pmr::vector<size_t> succ_offsets;
+        std::pmr::vector<size_t> succ_edges;
+        std::pmr::vector<size_t> pred_offsets;
+        std::pmr::vector<size_t> pred_edges;
+
+        size_t add_node_id(const Node &node);
+        void build_loops();
+        void build_csr(
+            const EdgeMap &map,
+            std::pmr::vector<size_t> &offsets,
+            std::pmr::vector<size_t> &edges);
 
         void append_to_nodemap(
-            NodeMap<NodeSet> &map, const Node &key, const Node &value);
+            EdgeMap &map, const Node &key, const Node &value);
         void append_to_nodemap(
-            NodeMap<NodeSet> &map, const Node &key, const NodeSet &values);
+            EdgeMap &map, const Node &key, const NodeSet &values);
         void append_to_nodemap(
-            NodeMap<NodeSet> &map, const NodeSet &nodes, const Node &prev);
+            EdgeMap &map, const NodeSet &nodes, const Node &prev);
     };
 }
@@ -0,0 +1,554 @@
+#include "internal.hh"
+
+#include <cctype>
+
+namespace whilelang {
+    using namespace trieste;
+
+    // Parses a program directly into the statements_wf form with one
+    // precedence climbing pass over the tokens, producing the same trees as
+    // the parser followed by the functions, expressions and statements
+    // passes. Any input it does not accept is left to the regular parser,
+    // which also reports the errors.
+    class FastParser {
+      public:
+        FastParser(Source source) : source(source), text(source->view()) {}
+
+        // The text is only read while tokenizing, so it can be a mapping
+        // of the input which is never copied as a whole
+        FastParser(std::string_view text, std::string origin)
+            : text(text), origin(std::move(origin)) {}
+
+        Node parse() {
+            if (!tokenize()) {
+                return {};
+            }
+            if (!source) {
+                intern();
+            }
+
+            try {
+                Node program = Program;
+                while (peek() != Lex::End) {
+                    program << fun_def();
+                    accept(Lex::Semi);
+                }
+
+                if (program->empty()) {
+                    return {};
+                }
+                return Top << program;
+            } catch (const Failure &) {
+                return {};
+            }
+        }
+
+      private:
+        enum class Lex {
+            End,
+            Ident,
+            Int,
+            Fun,
+            Var,
+            Return,
+            Skip,
+            If,
+            Then,
+            Else,
+            While,
+            Do,
+            Output,
+            Input,
+            True,
+            False,
+            Not,
+            And,
+            Or,
+            Assign,
+            Add,
+            Sub,
+            Mul,
+            LT,
+            Equals,
+            Semi,
+            Comma,
+            LParen,
+            RParen,
+            LBrace,
+            RBrace,
+        };
+
+        struct Lexeme {
+            Lex kind;
+            size_t pos;
+            size_t len;
+        };
+
+        struct Failure {};
+
+        Source source;
+        std::string_view text;
+        std::string origin;
+        std::vector<Lexeme> lexemes;
+        size_t current = 0;
+
+        static bool is_ident_start(char c) {
+            return std::isalpha(static_cast<unsigned char>(c)) || c == '_';
+        }
+
+        static bool is_ident_char(char c) {
+            return std::isalnum(static_cast<unsigned char>(c)) || c == '_';
+        }
+
+        static std::optional<Lex> keyword(std::string_view word) {
+            static const std::map<std::string_view, Lex> keywords = {
+                {"fun", Lex::Fun},
+                {"var", Lex::Var},
+                {"return", Lex::Return},
+                {"skip", Lex::Skip},
+                {"if", Lex::If},
+                {"then", Lex::Then},
+                {"else", Lex::Else},
+                {"while", Lex::While},
+                {"do", Lex::Do},
+                {"output", Lex::Output},
+                {"input", Lex::Input},
+                {"true", Lex::True},
+                {"false", Lex::False},
+                {"not", Lex::Not},
+                {"and", Lex::And},
+                {"or", Lex::Or},
+            };
+
+            auto res = keywords.find(word);
+            return res != keywords.end() ? std::optional(res->second)
+                                         : std::nullopt;
+        }
+
+        bool tokenize() {
+            static const std::map<char, Lex> symbols = {
+                {'+', Lex::Add},
+                {'-', Lex::Sub},
+                {'*', Lex::Mul},
+                {'<', Lex::LT},
+                {'=', Lex::Equals},
+                {';', Lex::Semi},
+                {',', Lex::Comma},
+                {'(', Lex::LParen},
+                {')', Lex::RParen},
+                {'{', Lex::LBrace},
+                {'}', Lex::RBrace},
+            };
+
+            size_t i = 0;
+            while (i < text.size()) {
+                char c = text[i];
+                size_t start = i;
+
+                if (std::isspace(static_cast<unsigned char>(c))) {
+                    i++;
+                } else if (text.substr(i, 2) == "//") {
+                    auto end = text.find('\n', i);
+                    i = end == std::string_view::npos ? text.size() : end;
+                } else if (text.substr(i, 2) == ":=") {
+                    i += 2;
+                    lexemes.push_back({Lex::Assign, start, 2});
+                } else if (std::isdigit(static_cast<unsigned char>(c))) {
+                    while (i < text.size() &&
+                           std::isdigit(static_cast<unsigned char>(text[i]))) {
+                        i++;
+                    }
+                    lexemes.push_back({Lex::Int, start, i - start});
+                } else if (is_ident_start(c)) {
+                    while (i < text.size() && is_ident_char(text[i])) {
+                        i++;
+                    }
+
+                    // The regular parser splits skip from any letters
+                    // following it
+                    auto word = text.substr(start, i - start);
+                    if (word.size() > 4 && word.starts_with("skip")) {
+                        return false;
+                    }
+
+                    auto kind = keyword(word).value_or(Lex::Ident);
+                    lexemes.push_back({kind, start, i - start});
+                } else if (symbols.contains(c)) {
+                    i++;
+                    lexemes.push_back({symbols.at(c), start, 1});
+                } else {
+                    return false;
+                }
+            }
+
+            lexemes.push_back({Lex::End, text.size(), 0});
+            return true;
+        }
+
+        // Copies the text of every leaf into a source of its own, each
+        // distinct text once, and moves the leaf lexemes into it
+        void intern() {
+            std::string leaves;
+            std::map<std::string_view, size_t> offsets;
+
+            for (auto &lexeme : lexemes) {
+                if (lexeme.kind != Lex::Ident && lexeme.kind != Lex::Int &&
+                    lexeme.kind != Lex::Input && lexeme.kind != Lex::True &&
+                    lexeme.kind != Lex::False) {
+                    continue;
+                }
+
+                auto word = text.substr(lexeme.pos, lexeme.len);
+                auto [res, inserted] =
+                    offsets.try_emplace(word, leaves.size());
+                if (inserted) {
+                    leaves += word;
+                }
+                lexeme.pos = res->second;
+            }
+            source = SourceDef::synthetic(leaves, origin);
+        }
+
+        Lex peek(size_t ahead = 0) const {
+            return lexemes[std::min(current + ahead, lexemes.size() - 1)].kind;
+        }
+
+        bool accept(Lex kind) {
+            if (peek() != kind) {
+                return false;
+            }
+            current++;
+            return true;
+        }
+
+        const Lexeme &expect(Lex kind) {
+            if (peek() != kind) {
+                throw Failure();
+            }
+            return lexemes[current++];
+        }
+
+        Node leaf(const Token &type, const Lexeme &lexeme) {
+            return type ^ Location(source, lexeme.pos, lexeme.len);
+        }
+
+        // fun f(p1, ..., pn) { body }
+        Node fun_def() {
+            expect(Lex::Fun);
+            auto name = leaf(Ident, expect(Lex::Ident));
+
+            Node params = ParamList;
+            expect(Lex::LParen);
+            if (peek() != Lex::RParen) {
+                do {
+                    params << (Param << leaf(Ident, expect(Lex::Ident)));
+                } while (accept(Lex::Comma));
+            }
+            expect(Lex::RParen);
+
+            expect(Lex::LBrace);
+            auto body = block(statements());
+            expect(Lex::RBrace);
+
+            return FunDef << (FunId << name) << params << body;
+        }
+
+        // Statements separated by semicolons form a block, a single
+        // statement without a semicolon is kept as it is
+        Node statements() {
+            Node block = Block;
+            bool separated = false;
+
+            block << statement();
+            while (accept(Lex::Semi)) {
+                separated = true;
+                if (peek() == Lex::RBrace || peek() == Lex::End) {
+                    break;
+                }
+                block << statement();
+            }
+
+            return separated ? Stmt << block : block->front();
+        }
+
+        Node block(Node stmt) {
+            return stmt->front() == Block ? stmt : Stmt << (Block << stmt);
+        }
+
+        Node statement() {
+            switch (peek()) {
+                case Lex::Skip:
+                    current++;
+                    return Stmt << Skip;
+
+                case Lex::Var:
+                    current++;
+                    return Stmt << (Var << leaf(Ident, expect(Lex::Ident)));
+
+                case Lex::Return:
+                    current++;
+                    return Stmt << (Return << aexpr());
+
+                case Lex::Output:
+                    current++;
+                    return Stmt << (Output << aexpr());
+
+                case Lex::Ident: {
+                    auto var = leaf(Ident, expect(Lex::Ident));
+                    expect(Lex::Assign);
+                    return Stmt << (Assign << var << aexpr());
+                }
+
+                case Lex::If: {
+                    current++;
+                    auto cond = bexpr();
+                    expect(Lex::Then);
+                    auto then = block(statement());
+                    expect(Lex::Else);
+                    auto else_ = block(statement());
+                    return Stmt << (If << cond << then << else_);
+                }
+
+                case Lex::While: {
+                    current++;
+                    auto cond = bexpr();
+                    expect(Lex::Do);
+                    auto body = block(statement());
+                    return Stmt << (While << cond << body);
+                }
+
+                case Lex::LBrace: {
+                    current++;
+                    auto stmt = statements();
+                    expect(Lex::RBrace);
+                    return stmt;
+                }
+
+                default:
+                    throw Failure();
+            }
+        }
+
+        Node aexpr() {
+            auto e = expression(0);
+            if (e != AExpr) {
+                throw Failure();
+            }
+            return e;
+        }
+
+        Node bexpr() {
+            auto e = expression(0);
+            if (e != BExpr) {
+                throw Failure();
+            }
+            return e;
+        }
+
+        // Binding strength of the binary operators, the operators of one
+        // level associate to the left
+        static int precedence(Lex kind) {
+            switch (kind) {
+                case Lex::Or:
+                    return 1;
+                case Lex::And:
+                    return 2;
+                case Lex::LT:
+                case Lex::Equals:
+                    return 3;
+                case Lex::Add:
+                case Lex::Sub:
+                    return 4;
+                case Lex::Mul:
+                    return 5;
+                default:
+                    return 0;
+            }
+        }
+
+        static Token operator_token(Lex kind) {
+            switch (kind) {
+                case Lex::Or:
+                    return Or;
+                case Lex::And:
+                    return And;
+                case Lex::LT:
+                    return LT;
+                case Lex::Equals:
+                    return Equals;
+                case Lex::Add:
+                    return Add;
+                case Lex::Sub:
+                    return Sub;
+                default:
+                    return Mul;
+            }
+        }
+
+        // Chains of the same arithmetic or logical operator share one node,
+        // as when the regular parser extends its sequence
+        Node expression(int min_precedence) {
+            auto lhs = primary();
+            std::optional<Lex> chain;
+
+            while (precedence(peek()) > min_precedence) {
+                auto kind = peek();
+                current++;
+                auto rhs = expression(precedence(kind));
+
+                bool logical = kind == Lex::And || kind == Lex::Or;
+                bool comparison = kind == Lex::LT || kind == Lex::Equals;
+                auto operand = logical ? BExpr : AExpr;
+                if (lhs != operand || rhs != operand) {
+                    throw Failure();
+                }
+
+                if (chain == kind && !comparison) {
+                    lhs->front() << rhs;
+                    continue;
+                }
+
+                auto op = operator_token(kind) << lhs << rhs;
+                lhs = (logical || comparison ? BExpr : AExpr) << op;
+                chain = kind;
+            }
+            return lhs;
+        }
+
+        Node primary() {
+            const auto &lexeme = lexemes[current];
+
+            switch (lexeme.kind) {
+                case Lex::Int:
+                    current++;
+                    return AExpr << leaf(Int, lexeme);
+
+                case Lex::Input:
+                    current++;
+                    return AExpr << leaf(Input, lexeme);
+
+                case Lex::True:
+                    current++;
+                    return BExpr << leaf(True, lexeme);
+
+                case Lex::False:
+                    current++;
+                    return BExpr << leaf(False, lexeme);
+
+                case Lex::Ident: {
+                    current++;
+                    auto ident = leaf(Ident, lexeme);
+                    if (!accept(Lex::LParen)) {
+                        return AExpr << ident;
+                    }
+
+                    Node args = ArgList;
+                    if (peek() != Lex::RParen) {
+                        do {
+                            args << (Arg << aexpr());
+                        } while (accept(Lex::Comma));
+                    }
+                    expect(Lex::RParen);
+
+                    return AExpr
+                        << (FunCall << (FunId << ident) << args);
+                }
+
+                // Not only applies to constants and parenthesized
+                // conditions
+                case Lex::Not: {
+                    current++;
+                    auto next = peek();
+                    if (next != Lex::True && next != Lex::False &&
+                        next != Lex::LParen) {
+                        throw Failure();
+                    }
+
+                    auto operand = primary();
+                    if (operand != BExpr) {
+                        throw Failure();
+                    }
+                    return BExpr << (Not << operand);
+                }
+
+                case Lex::LParen: {
+                    current++;
+                    auto e = expression(0);
+                    expect(Lex::RParen);
+                    return e;
+                }
+
+                default:
+                    throw Failure();
+            }
+        }
+    };
+
+    ProcessResult read_fast(
+        Source source,
+        std::shared_ptr<std::map<std::string, std::string>> vars_map,
+        bool run_stats,
+        bool run_mermaid,
+        bool run_ssa,
+        bool recycle_temps,
+        std::function<void()> parsed) {
+        auto ast = FastParser(source).parse();
+
+        if (!ast) {
+            return reader(
+                       vars_map,
+                       run_stats,
+                       run_mermaid,
+                       run_ssa,
+                       recycle_temps,
+                       parsed)
+                .source(source)
+                .read();
+        }
+
+        if (parsed) {
+            parsed();
+        }
+        return resolution(
+                   vars_map, run_stats, run_mermaid, run_ssa, recycle_temps)
+            .rewrite(ast);
+    }
+
+    ProcessResult read_mapped(
+        std::string_view text,
+        const std::string &origin,
+        std::shared_ptr<std::map<std::string, std::string>> vars_map,
+        bool run_stats,
+        bool run_mermaid,
+        bool run_ssa,
+        bool recycle_temps,
+        std::function<void()> parsed) {
+        if (auto ast = FastParser(text, origin).parse()) {
+            if (parsed) {
+                parsed();
+            }
+
+            auto result =
+                resolution(
+                    vars_map, run_stats, run_mermaid, run_ssa, recycle_temps)
+                    .rewrite(ast);
+            if (result.ok) {
+                return result;
+            }
+        }
+
+        // Errors are reported by the regular reader on a copy of the whole
+        // text, as the positions of the leaves are lost by interning them
+        vars_map->clear();
+        auto source = SourceDef::synthetic(std::string(text), origin);
+        return reader(
+                   vars_map,
+                   run_stats,
+                   run_mermaid,
+                   run_ssa,
+                   recycle_temps,
+                   parsed)
+            .source(source)
+            .read();
+    }
+}
@@ -6,16 +6,36 @@ namespace whilelang {
     using namespace trieste;
 
     // Parsing
-    Parse parser();
+    struct SourceChunk {
+        std::string_view text;
+        size_t line;
+    };
+
+    // Splits the source before every fun keyword outside of parentheses,
+    // braces and comments. Text before the first function is kept with it,
+    // so anything which is not a function is still reported by the parser.
+    std::vector<SourceChunk> split_functions(std::string_view text);
+    Parse parser(std::function<void()> parsed = {});
+    Reader function_reader();
+    Rewriter resolution(
+        std::shared_ptr<std::map<std::string, std::string>> vars_map,
+        bool run_stats,
+        bool run_mermaid,
+        bool run_ssa,
+        bool recycle_temps);
+    // Checks, names and normalizes a program of a single function
+    Rewriter function_resolution(
+        std::shared_ptr<std::map<std::string, std::string>> vars_map);
     PassDef functions();
     PassDef expressions();
     PassDef statements();
     PassDef check_refs();
     PassDef unique_variables(
-        std::shared_ptr<std::map<std::string, std::string>> vars_map);
+        std::shared_ptr<std::map<std::string, std::string>> vars_map,
+        bool scoped = false);
 
     // Evaluation
-    PassDef eval();
+    PassDef eval(std::shared_ptr<SlotAllocation> slots);
 
     // For performance testing
     PassDef gather_stats();
@@ -24,16 +44,40 @@ namespace whilelang {
     PassDef generate_mermaid(const wf::Wellformed &wf);
 
     // Pre static analysis
-    PassDef normalization();
+    PassDef normalization(bool recycle_temps);
     PassDef gather_functions(std::shared_ptr<ControlFlow> cfg);
     PassDef gather_instructions(std::shared_ptr<ControlFlow> cfg);
     PassDef gather_flow_graph(std::shared_ptr<ControlFlow> cfg);
+    PassDef build_control_flow(std::shared_ptr<ControlFlow> cfg);
+
+    // SSA
+    PassDef to_ssa();
+    PassDef from_ssa();
 
     // Static analysis
-    PassDef z_analysis(std::shared_ptr<ControlFlow> cfg);
-    PassDef constant_folding(std::shared_ptr<ControlFlow> cfg);
+    PassDef z_analysis(std::shared_ptr<ControlFlow> cfg, bool log_states);
+    PassDef constant_folding(
+        std::shared_ptr<ControlFlow> cfg,
+        bool demand_driven,
+        size_t call_string_depth);
     PassDef dead_code_elimination(std::shared_ptr<ControlFlow> cfg);
     PassDef dead_code_cleanup();
+    PassDef global_value_numbering();
+    PassDef loop_invariant_code_motion(std::shared_ptr<ControlFlow> cfg);
+    PassDef inline_functions(int threshold, int budget);
+    PassDef copy_propagation(std::shared_ptr<ControlFlow> cfg);
+    PassDef coalesce_temporaries();
+    PassDef strength_reduction(std::shared_ptr<ControlFlow> cfg);
+    PassDef partial_evaluation(size_t budget);
+    PassDef tail_recursion();
+    PassDef loop_unrolling(
+        std::shared_ptr<ControlFlow> cfg, size_t budget, size_t factor);
+    PassDef specialize_functions(size_t limit);
+
+    // Slot allocation
+    PassDef slot_allocation(
+        std::shared_ptr<ControlFlow> cfg,
+        std::shared_ptr<SlotAllocation> slots);
 
     // clang-format off
 	inline const auto parse_token =
@@ -156,4 +200,17 @@ namespace whilelang {
 		| (Return <<= Atom)
 		| (Arg <<= Atom)
 		;
+
+	// Phi nodes of an If are placed after the branches join, Lhs is the value
+	// from the then branch and Rhs the value from the else branch.
+	// Phi nodes of a While are placed at the loop header, Lhs is the value
+	// when entering the loop and Rhs the value at the end of the body.
+	// A variable not defined on entry has the phi itself as its Lhs.
+	inline const wf::Wellformed ssa_wf =
+		normalization_wf
+		| (If <<= BExpr * (Then >>= Stmt) * (Else >>= Stmt) * Phis)
+		| (While <<= Phis * BExpr * (Do >>= Stmt))
+		| (Phis <<= Phi++)
+		| (Phi <<= Ident * (Lhs >>= Atom) * (Rhs >>= Atom))
+		;
 }
@@ -4,10 +4,10 @@ namespace whilelang {
 
     using namespace trieste;
 
-    Rewriter interpret() {
+    Rewriter interpret(std::shared_ptr<SlotAllocation> slots) {
         return {
             "interpreter",
-            {eval()},
+            {eval(slots)},
             whilelang::normalization_wf,
         };
     }
@@ -0,0 +1,330 @@
+#include "json.hh"
+
+#include <cctype>
+#include <charconv>
+#include <cmath>
+#include <cstdio>
+
+namespace whilelang {
+
+    // Recursive descent over the text, every method leaves pos after the
+    // parsed value and returns false on malformed input
+    struct JsonReader {
+        std::string_view text;
+        size_t pos = 0;
+
+        void skip_space() {
+            while (pos < text.size() &&
+                   std::isspace(static_cast<unsigned char>(text[pos]))) {
+                pos++;
+            }
+        }
+
+        bool literal(std::string_view word) {
+            if (text.substr(pos, word.size()) != word) {
+                return false;
+            }
+            pos += word.size();
+            return true;
+        }
+
+        static void append_utf8(std::string &out, uint32_t code) {
+            if (code < 0x80) {
+                out += static_cast<char>(code);
+            } else if (code < 0x800) {
+                out += static_cast<char>(0xC0 | (code >> 6));
+                out += static_cast<char>(0x80 | (code & 0x3F));
+            } else if (code < 0x10000) {
+                out += static_cast<char>(0xE0 | (code >> 12));
+                out += static_cast<char>(0x80 | ((code >> 6) & 0x3F));
+                out += static_cast<char>(0x80 | (code & 0x3F));
+            } else {
+                out += static_cast<char>(0xF0 | (code >> 18));
+                out += static_cast<char>(0x80 | ((code >> 12) & 0x3F));
+                out += static_cast<char>(0x80 | ((code >> 6) & 0x3F));
+                out += static_cast<char>(0x80 | (code & 0x3F));
+            }
+        }
+
+        bool hex4(uint32_t &code) {
+            if (pos + 4 > text.size()) {
+                return false;
+            }
+            auto begin = text.data() + pos;
+            auto [end, err] = std::from_chars(begin, begin + 4, code, 16);
+            if (err != std::errc() || end != begin + 4) {
+                return false;
+            }
+            pos += 4;
+            return true;
+        }
+
+        bool string(std::string &out) {
+            if (!literal("\"")) {
+                return false;
+            }
+
+            while (pos < text.size() && text[pos] != '"') {
+                char c = text[pos++];
+                if (c != '\\') {
+                    out += c;
+                    continue;
+                }
+                if (pos >= text.size()) {
+                    return false;
+                }
+
+                switch (char e = text[pos++]) {
+                    case 'b':
+                        out += '\b';
+                        break;
+                    case 'f':
+                        out += '\f';
+                        break;
+                    case 'n':
+                        out += '\n';
+                        break;
+                    case 'r':
+                        out += '\r';
+                        break;
+                    case 't':
+                        out += '\t';
+                        break;
+                    case 'u': {
+                        uint32_t code;
+                        if (!hex4(code)) {
+                            return false;
+                        }
+
+                        // Characters outside the basic plane are written
+                        // as a surrogate pair
+                        uint32_t low;
+                        if (code >= 0xD800 && code < 0xDC00 &&
+                            literal("\\u") && hex4(low)) {
+                            code = 0x10000 + ((code - 0xD800) << 10) +
+                                (low - 0xDC00);
+                        }
+                        append_utf8(out, code);
+                        break;
+                    }
+                    default:
+                        out += e;
+                }
+            }
+            return literal("\"");
+        }
+
+        bool number(double &out) {
+            size_t start = pos;
+            while (pos < text.size() &&
+                   (std::isdigit(static_cast<unsigned char>(text[pos])) ||
+                    std::string_view("+-.eE").find(text[pos]) !=
+                        std::string_view::npos)) {
+                pos++;
+            }
+
+            try {
+                out = std::stod(std::string(text.substr(start, pos - start)));
+            } catch (const std::exception &) {
+                return false;
+            }
+            return true;
+        }
+
+        bool value(Json &out) {
+            skip_space();
+            if (pos >= text.size()) {
+                return false;
+            }
+
+            char c = text[pos];
+            if (c == '{') {
+                pos++;
+                Json::Object object;
+                skip_space();
+                if (literal("}")) {
+                    out = std::move(object);
+                    return true;
+                }
+
+                do {
+                    std::string key;
+                    skip_space();
+                    if (!string(key)) {
+                        return false;
+                    }
+                    skip_space();
+                    if (!literal(":") || !value(object[key])) {
+                        return false;
+                    }
+                    skip_space();
+                } while (literal(","));
+
+                out = std::move(object);
+                return literal("}");
+            } else if (c == '[') {
+                pos++;
+                Json::Array array;
+                skip_space();
+                if (literal("]")) {
+                    out = std::move(array);
+                    return true;
+                }
+
+                do {
+                    if (!value(array.emplace_back())) {
+                        return false;
+                    }
+                    skip_space();
+                } while (literal(","));
+
+                out = std::move(array);
+                return literal("]");
+            } else if (c == '"') {
+                std::string s;
+                if (!string(s)) {
+                    return false;
+                }
+                out = std::move(s);
+                return true;
+            } else if (literal("true")) {
+                out = true;
+                return true;
+            } else if (literal("false")) {
+                out = false;
+                return true;
+            } else if (literal("null")) {
+                out = nullptr;
+                return true;
+            }
+
+            double d;
+            if (!number(d)) {
+                return false;
+            }
+            out = d;
+            return true;
+        }
+    };
+
+    std::optional<Json> Json::parse(std::string_view text) {
+        JsonReader reader{text, 0};
+        Json res;
+
+        if (!reader.value(res)) {
+            return std::nullopt;
+        }
+        reader.skip_space();
+        if (reader.pos != text.size()) {
+            return std::nullopt;
+        }
+        return res;
+    }
+
+    std::string Json::dump() const {
+        std::string out;
+        dump(out);
+        return out;
+    }
+
+    void Json::dump(std::string &out) const {
+        if (auto b = std::get_if<bool>(&value)) {
+            out += *b ? "true" : "false";
+        } else if (auto d = std::get_if<double>(&value)) {
+            if (std::trunc(*d) == *d && std::abs(*d) < 1e15) {
+                out += std::to_string(static_cast<long long>(*d));
+            } else {
+                out += std::to_string(*d);
+            }
+        } else if (auto s = std::get_if<std::string>(&value)) {
+            out += '"';
+            for (char c : *s) {
+                switch (c) {
+                    case '"':
+                        out += "\\\"";
+                        break;
+                    case '\\':
+                        out += "\\\\";
+                        break;
+                    case '\n':
+                        out += "\\n";
+                        break;
+                    case '\r':
+                        out += "\\r";
+                        break;
+                    case '\t':
+                        out += "\\t";
+                        break;
+                    default:
+                        if (static_cast<unsigned char>(c) < 0x20) {
+                            char escaped[7];
+                            std::snprintf(
+                                escaped, sizeof(escaped), "\\u%04x", c);
+                            out += escaped;
+                        } else {
+                            out += c;
+                        }
+                }
+            }
+            out += '"';
+        } else if (auto a = std::get_if<Array>(&value)) {
+            out += '[';
+            for (size_t i = 0; i < a->size(); i++) {
+                if (i > 0) {
+                    out += ',';
+                }
+                (*a)[i].dump(out);
+            }
+            out += ']';
+        } else if (auto o = std::get_if<Object>(&value)) {
+            out += '{';
+            bool first = true;
+            for (const auto &[key, member] : *o) {
+                if (!first) {
+                    out += ',';
+                }
+                first = false;
+                Json(key).dump(out);
+                out += ':';
+                member.dump(out);
+            }
+            out += '}';
+        } else {
+            out += "null";
+        }
+    }
+
+    std::string Json::as_string() const {
+        auto s = std::get_if<std::string>(&value);
+        return s ? *s : std::string();
+    }
+
+    size_t Json::as_size() const {
+        auto d = std::get_if<double>(&value);
+        return d && *d > 0 ? static_cast<size_t>(*d) : 0;
+    }
+
+    const Json::Array &Json::as_array() const {
+        static const Array empty;
+        auto a = std::get_if<Array>(&value);
+        return a ? *a : empty;
+    }
+
+    const Json &Json::operator[](const std::string &key) const {
+        static const Json null;
+        auto o = std::get_if<Object>(&value);
+        if (!o) {
+            return null;
+        }
+
+        auto res = o->find(key);
+        return res != o->end() ? res->second : null;
+    }
+
+    Json &Json::operator[](const std::string &key) {
+        if (!is_object()) {
+            value = Object();
+        }
+        return std::get<Object>(value)[key];
+    }
+}
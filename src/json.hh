@@ -0,0 +1,70 @@
+#pragma once
+#include <map>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <variant>
+#include <vector>
+
+namespace whilelang {
+
+    // Minimal JSON value, enough for the messages of the language server
+    class Json {
+      public:
+        using Array = std::vector<Json>;
+        using Object = std::map<std::string, Json>;
+
+        Json() : value(nullptr) {}
+        Json(std::nullptr_t) : value(nullptr) {}
+        Json(bool b) : value(b) {}
+        Json(int i) : value(static_cast<double>(i)) {}
+        Json(size_t i) : value(static_cast<double>(i)) {}
+        Json(double d) : value(d) {}
+        Json(const char *s) : value(std::string(s)) {}
+        Json(std::string s) : value(std::move(s)) {}
+        Json(Array a) : value(std::move(a)) {}
+        Json(Object o) : value(std::move(o)) {}
+
+        // Returns an empty value if the text is not valid JSON
+        static std::optional<Json> parse(std::string_view text);
+
+        std::string dump() const;
+
+        inline bool is_null() const {
+            return std::holds_alternative<std::nullptr_t>(value);
+        };
+
+        inline bool is_string() const {
+            return std::holds_alternative<std::string>(value);
+        };
+
+        inline bool is_number() const {
+            return std::holds_alternative<double>(value);
+        };
+
+        inline bool is_array() const {
+            return std::holds_alternative<Array>(value);
+        };
+
+        inline bool is_object() const {
+            return std::holds_alternative<Object>(value);
+        };
+
+        // The accessors return a default value for the wrong type
+        std::string as_string() const;
+        size_t as_size() const;
+        const Array &as_array() const;
+
+        // Looks up a member, missing members and non objects give null
+        const Json &operator[](const std::string &key) const;
+
+        // Adds or replaces a member, turning the value into an object
+        Json &operator[](const std::string &key);
+
+      private:
+        std::variant<std::nullptr_t, bool, double, std::string, Array, Object>
+            value;
+
+        void dump(std::string &out) const;
+    };
+}
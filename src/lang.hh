@@ -7,9 +7,77 @@ namespace whilelang {
     Reader reader(
         std::shared_ptr<std::map<std::string, std::string>> vars_map,
         bool run_stats,
-        bool run_mermaid);
-    Rewriter interpret();
-    Rewriter optimization_analysis(bool run_zero_analysis);
+        bool run_mermaid,
+        bool run_ssa,
+        bool recycle_temps,
+        std::function<void()> parsed = {});
+    // Parses the source directly into statements, falling back to the
+    // regular parser for input it does not accept
+    ProcessResult read_fast(
+        Source source,
+        std::shared_ptr<std::map<std::string, std::string>> vars_map,
+        bool run_stats,
+        bool run_mermaid,
+        bool run_ssa,
+        bool recycle_temps,
+        std::function<void()> parsed = {});
+    // Parses the text of a mapped file like read_fast without copying it,
+    // only the identifiers and literals are copied into a source of their
+    // own. Programs with errors are copied and read by the regular reader.
+    ProcessResult read_mapped(
+        std::string_view text,
+        const std::string &origin,
+        std::shared_ptr<std::map<std::string, std::string>> vars_map,
+        bool run_stats,
+        bool run_mermaid,
+        bool run_ssa,
+        bool recycle_temps,
+        std::function<void()> parsed = {});
+    // Parses the top level functions of the source on up to jobs threads
+    // and resolves names in the merged program
+    ProcessResult read_parallel(
+        Source source,
+        size_t jobs,
+        std::shared_ptr<std::map<std::string, std::string>> vars_map,
+        bool run_stats,
+        bool run_mermaid,
+        bool run_ssa,
+        bool recycle_temps);
+    // Options controlling which passes run during the static analysis
+    struct OptimizationOptions {
+        bool run_zero_analysis = false;
+        bool three_pass_cfg = false; // Build the CFG with the gather passes
+        bool demand_constants = false; // Resolve constants only when used
+        size_t call_string_depth = 0; // Calls kept in analysis contexts
+        bool use_arena = true; // Allocate analysis state from a round arena
+        bool run_gvn = false; // Replace recomputed expressions
+        bool run_licm = false; // Hoist loop invariant assignments
+        bool run_inliner = false; // Inline calls chosen by the cost model
+        int inline_threshold = 8; // Max callee size exceeding the benefit
+        int inline_budget = 200; // Max statements added per round
+        bool run_copy_propagation = false; // Propagate and coalesce copies
+        bool run_strength_reduction = false; // Replace i * k in loops
+        bool run_tail_recursion = false; // Turn tail recursion into loops
+        bool run_partial_evaluation = false; // Run input free code
+        size_t partial_evaluation_budget = 10000; // Max evaluated steps
+        bool run_unrolling = false; // Unroll loops with known trip counts
+        size_t unroll_budget = 64; // Max statements added per round
+        size_t unroll_factor = 4; // Copies of the body in unrolled loops
+        bool run_specialization = false; // Clone functions for constants
+        size_t specialization_limit = 16; // Max clones created per round
+        bool run_slot_allocation = false; // Share slots between variables
+        bool log_states = false; // Log the state tables of the analyses
+    };
+
+    class SlotAllocation;
+
+    // With slots, variables sharing a slot share their value while running
+    Rewriter interpret(std::shared_ptr<SlotAllocation> slots = nullptr);
+    Rewriter optimization_analysis(const OptimizationOptions &options);
+    // Fills slots with the slot of every variable of the optimized program
+    Rewriter allocate_slots(
+        const OptimizationOptions &options,
+        std::shared_ptr<SlotAllocation> slots);
 
     // Program
     inline const auto Program = TokenDef("program");
@@ -97,4 +165,8 @@ namespace whilelang {
     inline const auto Normalize = TokenDef("normalize");
     inline const auto Atom = TokenDef("atom");
     inline const auto Instructions = TokenDef("instructions");
+
+    // SSA
+    inline const auto Phis = TokenDef("phis");
+    inline const auto Phi = TokenDef("phi");
 }
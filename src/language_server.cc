@@ -0,0 +1,1111 @@
+#include "language_server.hh"
+
+#include "analyses/constant_propagation.hh"
+#include "analyses/zero.hh"
+#include "internal.hh"
+#include "json.hh"
+#include "utils.hh"
+
+#include <algorithm>
+#include <chrono>
+
+namespace whilelang {
+    using namespace trieste;
+
+    // A function parsed on its own, reused for as long as its text is
+    // unchanged
+    struct ParsedFunction {
+        Source source;
+        ProcessResult result;
+    };
+
+    // Where a function starts in the document, lines and columns from zero
+    struct DocumentFunction {
+        size_t offset;
+        size_t line;
+        size_t column;
+        std::string name;
+        std::shared_ptr<ParsedFunction> parsed;
+    };
+
+    struct Diagnostic {
+        size_t line;
+        size_t column;
+        size_t end_line;
+        size_t end_column;
+        std::string message;
+    };
+
+    // A statement of the source, target is the position of the assigned
+    // variable of an assignment
+    struct SourceStatement {
+        size_t pos;
+        std::optional<size_t> target;
+    };
+
+    // The control flow graph of a single function. A call is followed by
+    // the assignment of its result, the values passed to and returned from
+    // other functions come from their summaries instead of edges.
+    struct FunctionFlow {
+        Node fun_def;
+        std::string name;
+        std::vector<std::string> params;
+        Vars vars;
+        Nodes instructions;
+        NodeMap<Nodes> predecessors;
+        NodeMap<Nodes> successors;
+        Nodes calls;
+        Nodes returns;
+        std::set<std::string> callees;
+    };
+
+    // Entry node and exit nodes of a statement of the function
+    struct FunctionFragment {
+        Node entry;
+        NodeSet exits;
+    };
+
+    // Builds the control flow of a function like FlowGraphBuilder, without
+    // leaving the function at calls
+    class FunctionFlowBuilder {
+      public:
+        FunctionFlowBuilder(FunctionFlow &flow) : flow(flow) {}
+
+        void function(const Node &fun_def) {
+            flow.fun_def = fun_def;
+            flow.name = get_identifier((fun_def / FunId) / Ident);
+            instruction(fun_def);
+
+            for (const auto &param : *(fun_def / ParamList)) {
+                auto var = get_identifier(param / Ident);
+                flow.params.push_back(var);
+                flow.vars.insert(var);
+            }
+
+            auto body = stmt(fun_def / Body);
+            edge({fun_def}, body.entry);
+        }
+
+      private:
+        FunctionFlow &flow;
+
+        void instruction(const Node &n) {
+            flow.instructions.push_back(n);
+            flow.predecessors[n];
+            flow.successors[n];
+        }
+
+        void edge(const NodeSet &from, const Node &to) {
+            for (const auto &n : from) {
+                flow.successors[n].push_back(to);
+                flow.predecessors[to].push_back(n);
+            }
+        }
+
+        FunctionFragment stmt(const Node &n) {
+            auto s = n / Stmt;
+
+            if (s == Block) {
+                auto first = stmt(s->front());
+                auto prev_exits = first.exits;
+
+                for (size_t i = 1; i < s->size(); i++) {
+                    auto next = stmt(s->at(i));
+                    edge(prev_exits, next.entry);
+                    prev_exits = std::move(next.exits);
+                }
+                return {first.entry, prev_exits};
+            } else if (s == While) {
+                auto b_expr = s / BExpr;
+                instruction(b_expr);
+                vars(b_expr);
+
+                auto body = stmt(s / Do);
+                edge(body.exits, b_expr);
+                edge({b_expr}, body.entry);
+
+                return {b_expr, {b_expr}};
+            } else if (s == If) {
+                auto b_expr = s / BExpr;
+                instruction(b_expr);
+                vars(b_expr);
+
+                auto then_stmt = stmt(s / Then);
+                auto else_stmt = stmt(s / Else);
+                edge({b_expr}, then_stmt.entry);
+                edge({b_expr}, else_stmt.entry);
+
+                auto exits = std::move(then_stmt.exits);
+                exits.insert(else_stmt.exits.begin(), else_stmt.exits.end());
+                return {b_expr, exits};
+            } else if (s == Assign && (s / Rhs) / Expr == FunCall) {
+                auto fun_call = (s / Rhs) / Expr;
+                instruction(fun_call);
+                instruction(s);
+                edge({fun_call}, s);
+
+                flow.calls.push_back(fun_call);
+                flow.callees.insert(
+                    get_identifier((fun_call / FunId) / Ident));
+                flow.vars.insert(get_identifier(s / Ident));
+                vars(fun_call / ArgList);
+
+                return {fun_call, {s}};
+            }
+
+            instruction(s);
+            if (s == Assign) {
+                flow.vars.insert(get_identifier(s / Ident));
+            } else if (s == Return) {
+                flow.returns.push_back(s);
+            }
+            vars(s);
+
+            return {s, {s}};
+        }
+
+        void vars(const Node &n) {
+            if (n == Atom) {
+                if ((n / Expr) == Ident) {
+                    flow.vars.insert(get_identifier(n / Expr));
+                }
+                return;
+            }
+
+            for (const auto &child : *n) {
+                vars(child);
+            }
+        }
+    };
+
+    // What a function is solved for: whether any call reaches it, the
+    // values of its parameters and the results of the functions it calls
+    template<typename Value>
+    struct FunctionInputs {
+        bool reached = false;
+        std::vector<Value> params;
+        std::map<std::string, Value> results;
+
+        bool operator==(const FunctionInputs &other) const = default;
+    };
+
+    // The states of a function for some inputs, with the summary of what
+    // it returns and the arguments of every call which was reached
+    template<typename State, typename Value, typename Impl>
+    struct FunctionSolution {
+        FunctionInputs<Value> inputs;
+        std::shared_ptr<Arena> arena = std::make_shared<Arena>();
+        typename Impl::StateTable states{arena->resource()};
+        Value result = Value::bottom();
+        std::vector<std::pair<std::string, std::vector<Value>>> arguments;
+    };
+
+    using CPSolution = FunctionSolution<CPState, CPLatticeValue, CPImpl>;
+    using ZeroSolution =
+        FunctionSolution<ZeroState, ZeroLatticeValue, ZeroImpl>;
+
+    // The solutions of a function for the inputs it was solved for in the
+    // last update, and the one for its inputs in the current result
+    template<typename Solution>
+    struct SolutionSet {
+        std::vector<std::shared_ptr<Solution>> cached;
+        std::shared_ptr<Solution> current;
+    };
+
+    // A function resolved on its own. Its variables are named after it, so
+    // the names and the solutions stay valid for as long as its text is
+    // unchanged.
+    struct ResolvedFunction {
+        std::shared_ptr<ParsedFunction> parsed;
+        ProcessResult result;
+        std::shared_ptr<std::map<std::string, std::string>> vars_map;
+        std::set<std::string> user_vars;
+        FunctionFlow flow;
+        SolutionSet<CPSolution> constants;
+        SolutionSet<ZeroSolution> zeros;
+    };
+
+    using ResolvedFunctions =
+        std::map<std::string, std::shared_ptr<ResolvedFunction>>;
+
+    // Fields of nodes are only found by name while a pass runs, so work on
+    // a resolved function runs inside of one
+    void
+    lsp_in_pass(const Node &top, std::function<void(const Node &)> work) {
+        PassDef pass = {
+            "lsp_function",
+            normalization_wf,
+            dir::topdown | dir::once,
+            {
+                T(Program)[Program] >> [&](Match &_) -> Node {
+                    work(_(Program));
+                    return NoChange;
+                },
+            }};
+        Rewriter("lsp_function", {pass}, normalization_wf).rewrite(top);
+    }
+
+    std::shared_ptr<ResolvedFunction>
+    lsp_resolve(std::shared_ptr<ParsedFunction> parsed) {
+        auto fun = std::make_shared<ResolvedFunction>();
+        fun->parsed = parsed;
+        fun->vars_map = std::make_shared<std::map<std::string, std::string>>();
+
+        Node program = Program;
+        for (const auto &fun_def : *parsed->result.ast->front()) {
+            program << fun_def->clone();
+        }
+        fun->result =
+            function_resolution(fun->vars_map).rewrite(Top << program);
+        if (!fun->result.ok) {
+            return fun;
+        }
+
+        for (const auto &[var, unique] : *fun->vars_map) {
+            fun->user_vars.insert(unique);
+        }
+        lsp_in_pass(fun->result.ast, [&](const Node &program) {
+            FunctionFlowBuilder(fun->flow).function(program->front());
+        });
+        return fun;
+    }
+
+    inline CPLatticeValue lsp_atom(const Node &atom, CPState &state) {
+        return atom_flow_helper(atom, state);
+    }
+
+    inline ZeroLatticeValue lsp_atom(const Node &atom, ZeroState &state) {
+        return handle_atom(atom / Expr, state);
+    }
+
+    // Runs the worklist algorithm over the function. Calls keep the state
+    // of the caller and assign the result of the callee, main starts with
+    // every variable unknown and other functions with only the parameters
+    // known.
+    template<typename State, typename Value, typename Impl>
+    std::shared_ptr<FunctionSolution<State, Value, Impl>> lsp_solve(
+        const FunctionFlow &flow,
+        const FunctionInputs<Value> &inputs,
+        Value unknown) {
+        auto solution =
+            std::make_shared<FunctionSolution<State, Value, Impl>>();
+        solution->inputs = inputs;
+
+        auto &table = solution->states;
+        for (const auto &inst : flow.instructions) {
+            table.try_emplace(
+                inst,
+                Impl::create_state(flow.vars, solution->arena->resource()));
+        }
+        if (!inputs.reached) {
+            return solution;
+        }
+
+        auto &entry = table[flow.fun_def];
+        for (auto &[_, value] : entry) {
+            value = flow.name == "main" ? unknown : Value::bottom();
+        }
+        for (size_t i = 0; i < flow.params.size(); i++) {
+            entry[flow.params[i]] = inputs.params[i];
+        }
+
+        NodeSet reached{flow.fun_def};
+        std::deque<Node> worklist{flow.fun_def};
+
+        while (!worklist.empty()) {
+            auto inst = worklist.front();
+            worklist.pop_front();
+
+            State out_state(table[inst], table[inst].get_allocator());
+            if (inst == Assign && (inst / Rhs) / Expr == FunCall) {
+                auto fun_call = (inst / Rhs) / Expr;
+                auto result = inputs.results.find(
+                    get_identifier((fun_call / FunId) / Ident));
+
+                out_state = table[fun_call];
+                out_state[get_identifier(inst / Ident)] =
+                    result != inputs.results.end() ? result->second
+                                                   : Value::bottom();
+            } else if (!inst->type().in({FunDef, FunCall})) {
+                out_state = Impl::flow(inst, table, nullptr);
+            }
+            table[inst] = out_state;
+
+            for (const auto &succ : flow.successors.at(inst)) {
+                if (Impl::state_join(table[succ], out_state)) {
+                    reached.insert(succ);
+                    worklist.push_back(succ);
+                }
+            }
+        }
+
+        for (const auto &ret : flow.returns) {
+            if (reached.contains(ret)) {
+                solution->result =
+                    solution->result.join(lsp_atom(ret / Atom, table[ret]));
+            }
+        }
+
+        for (const auto &fun_call : flow.calls) {
+            if (!reached.contains(fun_call)) {
+                continue;
+            }
+
+            std::vector<Value> args;
+            for (const auto &arg : *(fun_call / ArgList)) {
+                args.push_back(lsp_atom(arg / Atom, table[fun_call]));
+            }
+            solution->arguments.push_back(
+                {get_identifier((fun_call / FunId) / Ident), args});
+        }
+        return solution;
+    }
+
+    // The solution of a function for the inputs, the solver only runs if
+    // the function was not solved for the same inputs in the last update
+    template<typename State, typename Value, typename Impl>
+    std::shared_ptr<FunctionSolution<State, Value, Impl>> lsp_solution(
+        ResolvedFunction &fun,
+        SolutionSet<FunctionSolution<State, Value, Impl>> &set,
+        std::vector<std::shared_ptr<FunctionSolution<State, Value, Impl>>>
+            &used,
+        const FunctionInputs<Value> &inputs,
+        Value unknown,
+        std::set<std::string> &solved) {
+        auto same_inputs = [&](const auto &solution) {
+            return solution->inputs == inputs;
+        };
+
+        auto res = std::find_if(used.begin(), used.end(), same_inputs);
+        if (res == used.end()) {
+            auto cached =
+                std::find_if(set.cached.begin(), set.cached.end(), same_inputs);
+
+            if (cached != set.cached.end()) {
+                used.push_back(*cached);
+            } else {
+                lsp_in_pass(fun.result.ast, [&](const Node &) {
+                    used.push_back(lsp_solve<State, Value, Impl>(
+                        fun.flow, inputs, unknown));
+                });
+                solved.insert(fun.flow.name);
+            }
+            res = std::prev(used.end());
+        }
+
+        set.current = *res;
+        return *res;
+    }
+
+    // Solves the functions from main until the summaries no longer change.
+    // A function is solved again when its inputs change, which for callers
+    // is when the result of a callee changes and for callees when the
+    // arguments of a call change. Every update starts from unreached
+    // functions, so it gives the same solutions as solving every function
+    // from scratch, while the solutions of the last update are reused for
+    // every function whose text and inputs are unchanged.
+    template<typename State, typename Value, typename Impl>
+    void lsp_solve_program(
+        const ResolvedFunctions &functions,
+        SolutionSet<FunctionSolution<State, Value, Impl>>
+            ResolvedFunction::*member,
+        Value unknown,
+        std::set<std::string> &solved) {
+        using Solution = FunctionSolution<State, Value, Impl>;
+
+        std::map<std::string, FunctionInputs<Value>> inputs;
+        std::map<std::string, std::vector<std::shared_ptr<Solution>>> used;
+        for (const auto &[name, fun] : functions) {
+            auto &input = inputs[name];
+            input.params.assign(
+                fun->flow.params.size(),
+                name == "main" ? unknown : Value::bottom());
+            for (const auto &callee : fun->flow.callees) {
+                input.results[callee] = Value::bottom();
+            }
+            ((*fun).*member).current = nullptr;
+        }
+        inputs["main"].reached = true;
+
+        std::deque<std::string> worklist{"main"};
+        std::set<std::string> queued{"main"};
+        auto enqueue = [&](const std::string &name) {
+            if (queued.insert(name).second) {
+                worklist.push_back(name);
+            }
+        };
+
+        while (!worklist.empty()) {
+            auto name = worklist.front();
+            worklist.pop_front();
+            queued.erase(name);
+
+            auto &fun = *functions.at(name);
+            auto solution = lsp_solution<State, Value, Impl>(
+                fun, fun.*member, used[name], inputs[name], unknown, solved);
+
+            // Callers are solved again when the result changes
+            for (auto &[caller, input] : inputs) {
+                auto result = input.results.find(name);
+                if (result != input.results.end() &&
+                    result->second != solution->result) {
+                    result->second = solution->result;
+                    enqueue(caller);
+                }
+            }
+
+            // Callees are solved again when their parameters change
+            for (const auto &[callee, args] : solution->arguments) {
+                auto input = inputs.find(callee);
+                if (input == inputs.end()) {
+                    continue;
+                }
+
+                bool changed = !input->second.reached;
+                input->second.reached = true;
+
+                auto &params = input->second.params;
+                for (size_t i = 0; i < std::min(params.size(), args.size());
+                     i++) {
+                    auto value = params[i].join(args[i]);
+                    changed = changed || value != params[i];
+                    params[i] = value;
+                }
+                if (changed) {
+                    enqueue(callee);
+                }
+            }
+        }
+
+        // Functions which are never called only have unreached states
+        for (const auto &[name, fun] : functions) {
+            auto &set = (*fun).*member;
+            if (!set.current) {
+                lsp_solution<State, Value, Impl>(
+                    *fun, set, used[name], inputs[name], unknown, solved);
+            }
+            set.cached = std::move(used[name]);
+        }
+    }
+
+    // The state before the instruction is the join of its predecessors, the
+    // table holds the state after it
+    template<typename State, typename Impl, typename Solution>
+    State lsp_state_at(
+        const FunctionFlow &flow,
+        Solution &solution,
+        const Node &inst,
+        bool after) {
+        if (after) {
+            return solution.states[inst];
+        }
+
+        auto state =
+            Impl::create_state(flow.vars, solution.arena->resource());
+        for (const auto &pred : flow.predecessors.at(inst)) {
+            Impl::state_join(state, solution.states[pred]);
+        }
+        return state;
+    }
+
+    std::string lsp_describe(const CPLatticeValue &value) {
+        switch (value.type) {
+            case CPAbstractType::Constant:
+                return "constant " + std::to_string(*value.value);
+            case CPAbstractType::Bottom:
+                return "unreachable";
+            default:
+                return "not constant";
+        }
+    }
+
+    std::string lsp_describe(const ZeroLatticeValue &value) {
+        switch (value.type) {
+            case ZeroAbstractType::Zero:
+                return "zero";
+            case ZeroAbstractType::Positive:
+                return "positive";
+            case ZeroAbstractType::Negative:
+                return "negative";
+            case ZeroAbstractType::NonZero:
+                return "non zero";
+            case ZeroAbstractType::Bottom:
+                return "unreachable";
+            default:
+                return "unknown sign";
+        }
+    }
+
+    class Document {
+      public:
+        Document(std::string uri) : uri(std::move(uri)) {}
+
+        // Parses the functions whose text changed since the last update and
+        // analyzes the program if all of them are correct
+        void update(std::string new_text);
+
+        // The values of the variable under the position, if it is one
+        std::optional<std::string> hover(size_t line, size_t character);
+
+        inline const std::vector<Diagnostic> &get_diagnostics() const {
+            return diagnostics;
+        };
+
+        inline size_t reparsed_functions() const {
+            return reparsed;
+        };
+
+        inline size_t reanalyzed_functions() const {
+            return reanalyzed;
+        };
+
+        inline size_t total_functions() const {
+            return functions.size();
+        };
+
+      private:
+        std::string uri;
+        std::string text;
+        std::map<std::string, std::shared_ptr<ParsedFunction>> cache;
+        std::vector<DocumentFunction> functions;
+        std::vector<Diagnostic> diagnostics;
+        size_t reparsed = 0;
+        size_t reanalyzed = 0;
+
+        // Functions by name with their solutions from the last analysis,
+        // the solutions are only current if the program has no errors
+        ResolvedFunctions resolved;
+        bool analyzed = false;
+
+        static bool is_word_char(char c) {
+            return std::isalnum(static_cast<unsigned char>(c)) || c == '_';
+        }
+
+        void analyze();
+        void add_errors(const ProcessResult &result);
+        std::pair<size_t, size_t> locate(const Source &source, size_t pos);
+        std::vector<SourceStatement> scan_statements(size_t begin, size_t end);
+    };
+
+    void Document::update(std::string new_text) {
+        text = std::move(new_text);
+        functions.clear();
+        diagnostics.clear();
+        analyzed = false;
+        reparsed = 0;
+        reanalyzed = 0;
+
+        auto chunks = split_functions(text);
+        if (chunks.empty()) {
+            chunks.push_back({text, 1});
+        }
+
+        // Functions which are no longer in the document are dropped from
+        // the cache
+        std::map<std::string, std::shared_ptr<ParsedFunction>> parsed;
+        bool ok = true;
+
+        for (const auto &chunk : chunks) {
+            auto key = std::string(chunk.text);
+            auto res = cache.find(key);
+            std::shared_ptr<ParsedFunction> fun;
+
+            if (res != cache.end()) {
+                fun = res->second;
+            } else {
+                auto source = SourceDef::synthetic(key, uri);
+                fun = std::make_shared<ParsedFunction>(ParsedFunction{
+                    source, function_reader().source(source).read()});
+                reparsed++;
+            }
+            parsed[key] = fun;
+
+            size_t offset = chunk.text.data() - text.data();
+            auto newline =
+                offset == 0 ? std::string::npos : text.rfind('\n', offset - 1);
+            size_t column =
+                newline == std::string::npos ? offset : offset - newline - 1;
+
+            std::string name;
+            if (fun->result.ok && !fun->result.ast->front()->empty()) {
+                auto fun_def = fun->result.ast->front()->front();
+                name = get_identifier(fun_def->front()->front());
+            } else {
+                ok = false;
+            }
+
+            functions.push_back({offset, chunk.line - 1, column, name, fun});
+        }
+        cache = std::move(parsed);
+
+        for (const auto &fun : functions) {
+            add_errors(fun.parsed->result);
+        }
+        if (ok) {
+            analyze();
+        }
+    }
+
+    // Every function is resolved on its own and kept until its text
+    // changes, so an edit only resolves the edited functions. The analyses
+    // then solve each function over its own control flow graph, joined
+    // through the summaries of the parameters and results of the functions.
+    void Document::analyze() {
+        ResolvedFunctions current;
+        bool ok = true;
+
+        for (const auto &fun : functions) {
+            auto res = resolved.find(fun.name);
+            auto function = res != resolved.end() &&
+                    res->second->parsed == fun.parsed
+                ? res->second
+                : lsp_resolve(fun.parsed);
+
+            if (!function->result.ok) {
+                add_errors(function->result);
+                ok = false;
+            }
+            current[fun.name] = function;
+        }
+        resolved = std::move(current);
+
+        if (!ok || !resolved.contains("main")) {
+            return;
+        }
+
+        std::set<std::string> solved;
+        lsp_solve_program<CPState, CPLatticeValue, CPImpl>(
+            resolved,
+            &ResolvedFunction::constants,
+            CPLatticeValue::top(),
+            solved);
+        lsp_solve_program<ZeroState, ZeroLatticeValue, ZeroImpl>(
+            resolved,
+            &ResolvedFunction::zeros,
+            ZeroLatticeValue::top(),
+            solved);
+
+        reanalyzed = solved.size();
+        analyzed = true;
+    }
+
+    void Document::add_errors(const ProcessResult &result) {
+        for (const auto &error : result.errors) {
+            std::string message;
+            Location loc;
+
+            for (const auto &child : *error) {
+                if (child == ErrorMsg) {
+                    message = std::string(child->location().view());
+                } else if (child == ErrorAst) {
+                    loc = child->empty() ? child->location()
+                                         : child->front()->location();
+                }
+            }
+
+            auto [line, column] = locate(loc.source, loc.pos);
+            auto [end_line, end_column] =
+                locate(loc.source, loc.pos + std::max<size_t>(loc.len, 1));
+            diagnostics.push_back(
+                {line, column, end_line, end_column, message});
+        }
+    }
+
+    // Positions in the source of a function are moved to where the
+    // function starts in the document
+    std::pair<size_t, size_t>
+    Document::locate(const Source &source, size_t pos) {
+        for (const auto &fun : functions) {
+            if (fun.parsed->source != source) {
+                continue;
+            }
+
+            auto [line, column] = source->linecol(pos);
+            return {
+                fun.line + line, line == 0 ? fun.column + column : column};
+        }
+        return {0, 0};
+    }
+
+    // The statements of the function in the order normalization keeps
+    // their instructions, conditions come before the branches and bodies
+    std::vector<SourceStatement>
+    Document::scan_statements(size_t begin, size_t end) {
+        static const std::set<std::string_view> keywords = {
+            "skip", "var", "output", "return", "if", "while"};
+        std::string_view view(text);
+        std::vector<SourceStatement> statements;
+
+        size_t i = begin;
+        while (i < end) {
+            if (view.substr(i, 2) == "//") {
+                i = std::min(end, view.find('\n', i));
+                continue;
+            }
+            if (!is_word_char(view[i])) {
+                i++;
+                continue;
+            }
+
+            size_t start = i;
+            while (i < end && is_word_char(view[i])) {
+                i++;
+            }
+
+            auto word = view.substr(start, i - start);
+            if (keywords.contains(word)) {
+                statements.push_back({start, std::nullopt});
+                continue;
+            }
+
+            size_t next = i;
+            while (next < end &&
+                   std::isspace(static_cast<unsigned char>(view[next]))) {
+                next++;
+            }
+            if (view.substr(next, 2) == ":=") {
+                statements.push_back({start, start});
+            }
+        }
+        return statements;
+    }
+
+    void lsp_collect_instructions(
+        const Node &n, const std::set<std::string> &user_vars, Nodes &res) {
+        if (n == Assign) {
+            // Temporaries of normalization have no statement in the source
+            if (user_vars.contains(get_identifier(n->front()))) {
+                res.push_back(n);
+            }
+        } else if (n->type().in({Skip, Output, Return, BExpr})) {
+            res.push_back(n);
+        } else {
+            for (const auto &child : *n) {
+                lsp_collect_instructions(child, user_vars, res);
+            }
+        }
+    }
+
+    std::optional<std::string>
+    Document::hover(size_t line, size_t character) {
+        if (!analyzed) {
+            return std::nullopt;
+        }
+
+        size_t offset = 0;
+        for (size_t i = 0; i < line && offset != std::string::npos; i++) {
+            offset = text.find('\n', offset);
+            offset = offset == std::string::npos ? offset : offset + 1;
+        }
+        if (offset == std::string::npos || offset + character >= text.size()) {
+            return std::nullopt;
+        }
+        offset += character;
+
+        size_t begin = offset;
+        size_t end = offset;
+        while (begin > 0 && is_word_char(text[begin - 1])) {
+            begin--;
+        }
+        while (end < text.size() && is_word_char(text[end])) {
+            end++;
+        }
+
+        auto fun = std::find_if(
+            functions.rbegin(), functions.rend(), [&](const auto &fun) {
+                return fun.offset <= begin;
+            });
+        if (begin == end || fun == functions.rend()) {
+            return std::nullopt;
+        }
+
+        auto res = resolved.find(fun->name);
+        if (res == resolved.end() || res->second->parsed != fun->parsed) {
+            return std::nullopt;
+        }
+        auto &function = *res->second;
+
+        auto word = text.substr(begin, end - begin);
+        auto var = function.vars_map->find(fun->name + "-" + word);
+        if (var == function.vars_map->end()) {
+            return std::nullopt;
+        }
+
+        // The instructions of a function match its statements one to one,
+        // a variable is shown with its value before the statement, or after
+        // it where it is assigned
+        size_t fun_end = fun == functions.rbegin() ? text.size()
+                                                   : std::prev(fun)->offset;
+        auto statements = scan_statements(fun->offset, fun_end);
+        Nodes insts;
+        lsp_collect_instructions(
+            function.flow.fun_def->back(), function.user_vars, insts);
+        if (statements.size() != insts.size()) {
+            return std::nullopt;
+        }
+
+        // Parameters have the values passed by the callers
+        Node inst = function.flow.fun_def;
+        bool after = true;
+        for (size_t i = 0; i < statements.size(); i++) {
+            if (statements[i].pos <= begin) {
+                inst = insts[i];
+                after = statements[i].target == begin;
+            }
+        }
+
+        if (!after && inst == Assign && inst->back()->front() == FunCall) {
+            // The state reaching a call is the one before the call
+            inst = inst->back()->front();
+        }
+
+        auto constants = lsp_state_at<CPState, CPImpl>(
+            function.flow, *function.constants.current, inst, after);
+        auto zeros = lsp_state_at<ZeroState, ZeroImpl>(
+            function.flow, *function.zeros.current, inst, after);
+        auto constant = constants[var->second];
+        auto zero = zeros[var->second];
+
+        return "`" + word + "`: " + lsp_describe(constant) + ", " +
+            lsp_describe(zero);
+    }
+
+    class LanguageServer {
+      public:
+        LanguageServer(std::istream &in, std::ostream &out)
+            : in(in), out(out) {}
+
+        int run();
+
+      private:
+        std::istream &in;
+        std::ostream &out;
+        std::map<std::string, Document> documents;
+        bool shutdown = false;
+
+        std::optional<std::string> read_message();
+        void send(const Json &message);
+        void respond(const Json &id, Json result);
+        void respond_error(const Json &id, int code, std::string message);
+        void notify(std::string method, Json params);
+
+        void handle(const Json &message);
+        void update(const std::string &uri, std::string text);
+        void publish_diagnostics(const std::string &uri);
+        Json hover(const Json &params);
+    };
+
+    // Messages are a header with the length of the content, an empty line
+    // and the JSON content
+    std::optional<std::string> LanguageServer::read_message() {
+        size_t length = 0;
+        std::string line;
+
+        while (std::getline(in, line)) {
+            if (!line.empty() && line.back() == '\r') {
+                line.pop_back();
+            }
+            if (line.empty()) {
+                break;
+            }
+
+            const std::string header = "Content-Length:";
+            if (line.starts_with(header)) {
+                length = std::stoul(line.substr(header.size()));
+            }
+        }
+
+        if (!in || length == 0) {
+            return std::nullopt;
+        }
+
+        std::string content(length, '\0');
+        in.read(content.data(), length);
+        if (!in) {
+            return std::nullopt;
+        }
+        return content;
+    }
+
+    void LanguageServer::send(const Json &message) {
+        auto content = message.dump();
+        out << "Content-Length: " << content.size() << "\r\n\r\n"
+            << content;
+        out.flush();
+    }
+
+    void LanguageServer::respond(const Json &id, Json result) {
+        Json message;
+        message["jsonrpc"] = "2.0";
+        message["id"] = id;
+        message["result"] = std::move(result);
+        send(message);
+    }
+
+    void LanguageServer::respond_error(
+        const Json &id, int code, std::string text) {
+        Json error;
+        error["code"] = code;
+        error["message"] = std::move(text);
+
+        Json message;
+        message["jsonrpc"] = "2.0";
+        message["id"] = id;
+        message["error"] = std::move(error);
+        send(message);
+    }
+
+    void LanguageServer::notify(std::string method, Json params) {
+        Json message;
+        message["jsonrpc"] = "2.0";
+        message["method"] = std::move(method);
+        message["params"] = std::move(params);
+        send(message);
+    }
+
+    int LanguageServer::run() {
+        while (auto content = read_message()) {
+            auto message = Json::parse(*content);
+            if (!message) {
+                respond_error(nullptr, -32700, "Invalid JSON");
+                continue;
+            }
+
+            // Members are read through the const overload, which never
+            // inserts into the message
+            const Json &msg = *message;
+            if (msg["method"].as_string() == "exit") {
+                return shutdown ? 0 : 1;
+            }
+
+            try {
+                handle(msg);
+            } catch (const std::exception &e) {
+                if (!msg["id"].is_null()) {
+                    respond_error(msg["id"], -32603, e.what());
+                }
+            }
+        }
+        return shutdown ? 0 : 1;
+    }
+
+    void LanguageServer::handle(const Json &message) {
+        auto method = message["method"].as_string();
+        const auto &id = message["id"];
+        const auto &params = message["params"];
+
+        if (method == "initialize") {
+            // Documents are always sent in full
+            Json capabilities;
+            capabilities["textDocumentSync"] = 1;
+            capabilities["hoverProvider"] = true;
+
+            Json info;
+            info["name"] = "while_lsp";
+
+            Json result;
+            result["capabilities"] = std::move(capabilities);
+            result["serverInfo"] = std::move(info);
+            respond(id, std::move(result));
+        } else if (method == "shutdown") {
+            shutdown = true;
+            respond(id, nullptr);
+        } else if (method == "textDocument/didOpen") {
+            const auto &doc = params["textDocument"];
+            update(doc["uri"].as_string(), doc["text"].as_string());
+        } else if (method == "textDocument/didChange") {
+            const auto &changes = params["contentChanges"].as_array();
+            if (!changes.empty()) {
+                update(
+                    params["textDocument"]["uri"].as_string(),
+                    changes.back()["text"].as_string());
+            }
+        } else if (method == "textDocument/didClose") {
+            auto uri = params["textDocument"]["uri"].as_string();
+            documents.erase(uri);
+
+            Json diagnostics;
+            diagnostics["uri"] = uri;
+            diagnostics["diagnostics"] = Json::Array();
+            notify("textDocument/publishDiagnostics", std::move(diagnostics));
+        } else if (method == "textDocument/hover") {
+            respond(id, hover(params));
+        } else if (!id.is_null()) {
+            respond_error(id, -32601, "Unsupported method " + method);
+        }
+    }
+
+    void LanguageServer::update(const std::string &uri, std::string text) {
+        using clock = std::chrono::steady_clock;
+        auto start = clock::now();
+
+        auto &doc = documents.try_emplace(uri, uri).first->second;
+        doc.update(std::move(text));
+
+        auto time = std::chrono::duration_cast<std::chrono::microseconds>(
+            clock::now() - start);
+        Json log;
+        log["type"] = 4;
+        log["message"] = "Parsed " + std::to_string(doc.reparsed_functions()) +
+            " and analyzed " + std::to_string(doc.reanalyzed_functions()) +
+            " of " + std::to_string(doc.total_functions()) + " functions in " +
+            std::to_string(time.count()) + " us";
+        notify("window/logMessage", std::move(log));
+
+        publish_diagnostics(uri);
+    }
+
+    void LanguageServer::publish_diagnostics(const std::string &uri) {
+        auto position = [](size_t line, size_t column) {
+            Json res;
+            res["line"] = line;
+            res["character"] = column;
+            return res;
+        };
+
+        Json::Array diagnostics;
+        for (const auto &diag : documents.at(uri).get_diagnostics()) {
+            Json range;
+            range["start"] = position(diag.line, diag.column);
+            range["end"] = position(diag.end_line, diag.end_column);
+
+            Json diagnostic;
+            diagnostic["range"] = std::move(range);
+            diagnostic["severity"] = 1;
+            diagnostic["source"] = "while";
+            diagnostic["message"] = diag.message;
+            diagnostics.push_back(std::move(diagnostic));
+        }
+
+        Json params;
+        params["uri"] = uri;
+        params["diagnostics"] = std::move(diagnostics);
+        notify("textDocument/publishDiagnostics", std::move(params));
+    }
+
+    Json LanguageServer::hover(const Json &params) {
+        auto doc = documents.find(params["textDocument"]["uri"].as_string());
+        if (doc == documents.end()) {
+            return nullptr;
+        }
+
+        const auto &position = params["position"];
+        auto value = doc->second.hover(
+            position["line"].as_size(), position["character"].as_size());
+        if (!value) {
+            return nullptr;
+        }
+
+        Json contents;
+        contents["kind"] = "markdown";
+        contents["value"] = *value;
+
+        Json result;
+        result["contents"] = std::move(contents);
+        return result;
+    }
+
+    int run_language_server(std::istream &in, std::ostream &out) {
+        return LanguageServer(in, out).run();
+    }
+}
@@ -0,0 +1,13 @@
+#pragma once
+#include <iostream>
+
+namespace whilelang {
+
+    // Serves the language server protocol over the given streams until the
+    // client sends exit, returning the exit code of the server.
+    // Documents are kept in memory between edits: only functions whose text
+    // changed are parsed and resolved again, and only functions whose text
+    // or summaries changed are analyzed again. Hovering a variable shows
+    // the values found by constant propagation and the zero analysis.
+    int run_language_server(std::istream &in, std::ostream &out);
+}
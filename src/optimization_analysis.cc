@@ -1,29 +1,122 @@
+#include "analyses/slot_allocation.hh"
 #include "internal.hh"
 
 namespace whilelang {
     using namespace trieste;
 
-    Rewriter optimization_analysis(bool run_zero_analysis) {
-        auto cfg = std::make_shared<ControlFlow>();
-        auto cfg_is_dirty = [=](Node) { return cfg->is_dirty(); };
-        auto run_zero = [=](Node) { return run_zero_analysis; };
+    Rewriter optimization_analysis(const OptimizationOptions &options) {
+        // All containers of the round share one arena, released when the
+        // rewriter is destroyed
+        auto cfg = std::make_shared<ControlFlow>(
+            std::make_shared<Arena>(options.use_arena));
+        auto run_zero = [=](Node) { return options.run_zero_analysis; };
+        auto run_gvn = [=](Node) { return options.run_gvn; };
+        auto run_licm = [=](Node) { return options.run_licm; };
+        auto run_inliner = [=](Node) { return options.run_inliner; };
+        auto run_tail_recursion = [=](Node) {
+            return options.run_tail_recursion;
+        };
+        auto run_partial_evaluation = [=](Node) {
+            return options.run_partial_evaluation;
+        };
+        auto run_strength_reduction = [=](Node) {
+            return options.run_strength_reduction;
+        };
+        auto run_specialization = [=](Node) {
+            return options.run_specialization;
+        };
+        auto run_unrolling = [=](Node) { return options.run_unrolling; };
+        auto run_copy_prop = [=](Node) {
+            return options.run_copy_propagation;
+        };
+        auto single_pass = [=](Node) { return !options.three_pass_cfg; };
+        auto three_pass = [=](Node) { return options.three_pass_cfg; };
+        auto single_pass_dirty = [=](Node) {
+            return !options.three_pass_cfg && cfg->is_dirty();
+        };
+        auto three_pass_dirty = [=](Node) {
+            return options.three_pass_cfg && cfg->is_dirty();
+        };
 
         Rewriter rewriter = {
             "optimization_analysis",
             {
-                gather_functions(cfg),
-                gather_instructions(cfg),
-                gather_flow_graph(cfg),
+                tail_recursion().cond(run_tail_recursion),
+                inline_functions(options.inline_threshold, options.inline_budget)
+                    .cond(run_inliner),
+                specialize_functions(options.specialization_limit)
+                    .cond(run_specialization),
+                partial_evaluation(options.partial_evaluation_budget)
+                    .cond(run_partial_evaluation),
+                global_value_numbering().cond(run_gvn),
+
+                build_control_flow(cfg).cond(single_pass),
+                gather_functions(cfg).cond(three_pass),
+                gather_instructions(cfg).cond(three_pass),
+                gather_flow_graph(cfg).cond(three_pass),
+
+                z_analysis(cfg, options.log_states).cond(run_zero),
+                constant_folding(
+                    cfg, options.demand_constants, options.call_string_depth),
+
+                build_control_flow(cfg).cond(single_pass_dirty),
+                gather_functions(cfg).cond(three_pass_dirty),
+                gather_instructions(cfg).cond(three_pass_dirty),
+                gather_flow_graph(cfg).cond(three_pass_dirty),
+
+                copy_propagation(cfg).cond(run_copy_prop),
+
+                build_control_flow(cfg).cond(single_pass_dirty),
+                gather_functions(cfg).cond(three_pass_dirty),
+                gather_instructions(cfg).cond(three_pass_dirty),
+                gather_flow_graph(cfg).cond(three_pass_dirty),
+
+                loop_invariant_code_motion(cfg).cond(run_licm),
 
-                z_analysis(cfg).cond(run_zero),
-                constant_folding(cfg),
+                build_control_flow(cfg).cond(single_pass_dirty),
+                gather_functions(cfg).cond(three_pass_dirty),
+                gather_instructions(cfg).cond(three_pass_dirty),
+                gather_flow_graph(cfg).cond(three_pass_dirty),
 
-                gather_functions(cfg).cond(cfg_is_dirty),
-                gather_instructions(cfg).cond(cfg_is_dirty),
-                gather_flow_graph(cfg).cond(cfg_is_dirty),
+                strength_reduction(cfg).cond(run_strength_reduction),
+
+                build_control_flow(cfg).cond(single_pass_dirty),
+                gather_functions(cfg).cond(three_pass_dirty),
+                gather_instructions(cfg).cond(three_pass_dirty),
+                gather_flow_graph(cfg).cond(three_pass_dirty),
+
+                loop_unrolling(
+                    cfg, options.unroll_budget, options.unroll_factor)
+                    .cond(run_unrolling),
+
+                build_control_flow(cfg).cond(single_pass_dirty),
+                gather_functions(cfg).cond(three_pass_dirty),
+                gather_instructions(cfg).cond(three_pass_dirty),
+                gather_flow_graph(cfg).cond(three_pass_dirty),
 
                 dead_code_elimination(cfg),
                 dead_code_cleanup(),
+                coalesce_temporaries().cond(run_copy_prop),
+            },
+            whilelang::normalization_wf,
+        };
+
+        return rewriter;
+    }
+
+    // Runs once on the optimized program, the slots are only valid as long
+    // as the program is not changed
+    Rewriter allocate_slots(
+        const OptimizationOptions &options,
+        std::shared_ptr<SlotAllocation> slots) {
+        auto cfg = std::make_shared<ControlFlow>(
+            std::make_shared<Arena>(options.use_arena));
+
+        Rewriter rewriter = {
+            "allocate_slots",
+            {
+                build_control_flow(cfg),
+                slot_allocation(cfg, slots),
             },
             whilelang::normalization_wf,
         };
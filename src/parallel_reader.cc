@@ -0,0 +1,109 @@
+#include "internal.hh"
+
+#include <atomic>
+#include <cctype>
+#include <thread>
+
+namespace whilelang {
+    using namespace trieste;
+
+    bool is_ident_char(char c) {
+        return std::isalnum(static_cast<unsigned char>(c)) || c == '_';
+    }
+
+    std::vector<SourceChunk> split_functions(std::string_view text) {
+        std::vector<SourceChunk> chunks;
+        size_t line = 1;
+        int depth = 0;
+
+        for (size_t i = 0; i < text.size(); i++) {
+            char c = text[i];
+
+            if (c == '\n') {
+                line++;
+            } else if (text.substr(i, 2) == "//") {
+                // Line comments may contain anything up to the newline
+                auto end = text.find('\n', i);
+                i = (end == std::string_view::npos ? text.size() : end) - 1;
+            } else if (c == '{' || c == '(') {
+                depth++;
+            } else if (c == '}' || c == ')') {
+                depth--;
+            } else if (
+                depth == 0 && text.substr(i, 3) == "fun" &&
+                (i == 0 || !is_ident_char(text[i - 1])) &&
+                (i + 3 == text.size() || !is_ident_char(text[i + 3]))) {
+                chunks.push_back({text.substr(i), line});
+            }
+        }
+
+        for (size_t i = 0; i < chunks.size(); i++) {
+            auto end = i + 1 < chunks.size() ? chunks[i + 1].text.data()
+                                             : text.data() + text.size();
+            auto begin = i == 0 ? text.data() : chunks[i].text.data();
+
+            chunks[i].text = std::string_view(begin, end - begin);
+        }
+        if (!chunks.empty()) {
+            chunks.front().line = 1;
+        }
+        return chunks;
+    }
+
+    ProcessResult read_parallel(
+        Source source,
+        size_t jobs,
+        std::shared_ptr<std::map<std::string, std::string>> vars_map,
+        bool run_stats,
+        bool run_mermaid,
+        bool run_ssa,
+        bool recycle_temps) {
+        auto chunks = split_functions(source->view());
+
+        if (jobs <= 1 || chunks.size() <= 1) {
+            return reader(
+                       vars_map, run_stats, run_mermaid, run_ssa, recycle_temps)
+                .source(source)
+                .read();
+        }
+
+        // Every function is parsed into its own tree, with the line it
+        // starts on in the origin so errors can still be located
+        std::vector<ProcessResult> results(chunks.size());
+        std::atomic<size_t> next = 0;
+
+        auto worker = [&]() {
+            for (size_t i = next++; i < chunks.size(); i = next++) {
+                auto origin =
+                    source->origin() + ":" + std::to_string(chunks[i].line);
+
+                results[i] = function_reader()
+                                 .synthetic(std::string(chunks[i].text), origin)
+                                 .read();
+            }
+        };
+
+        std::vector<std::thread> threads;
+        for (size_t i = 0; i < std::min(jobs, chunks.size()); i++) {
+            threads.emplace_back(worker);
+        }
+        for (auto &thread : threads) {
+            thread.join();
+        }
+
+        Node program = Program;
+        for (const auto &result : results) {
+            if (!result.ok) {
+                return result;
+            }
+
+            for (const auto &fun_def : *(result.ast / Program)) {
+                program << fun_def;
+            }
+        }
+
+        return resolution(
+                   vars_map, run_stats, run_mermaid, run_ssa, recycle_temps)
+            .rewrite(Top << program);
+    }
+}
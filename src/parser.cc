@@ -5,7 +5,7 @@ namespace whilelang {
     using namespace trieste;
     using namespace trieste::detail;
 
-    Parse parser() {
+    Parse parser(std::function<void()> parsed) {
         Parse p(depth::file, parse_wf);
 
         auto infix = [](Make &m, Token t) {
@@ -13,8 +13,9 @@ namespace whilelang {
             // have *higher* precedence, and which should therefore be
             // terminated when that operator is encountered. Note that operators
             // with the same precedence terminate each other. (for reasons, it
-            // has to be defined inside the lambda)
-            const auto precedence_table =
+            // has to be defined inside the lambda, static so that it is only
+            // built once rather than for every operator)
+            static const auto precedence_table =
                 std::map<Token, std::initializer_list<Token>>{
                     {Mul, {}},
                     {Add, {Sub, Mul}},
@@ -180,8 +181,12 @@ namespace whilelang {
                   },
           });
 
-        p.done([pop_until](auto &m) {
+        p.done([pop_until, parsed](auto &m) {
             pop_until(m, File, {Paren, If, Then, While});
+
+            if (parsed) {
+                parsed();
+            }
         });
 
         return p;
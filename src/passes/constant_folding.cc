@@ -1,4 +1,5 @@
 #include "../analyses/constant_propagation.hh"
+#include "../analyses/constant_query.hh"
 #include "../analyses/dataflow_analysis.hh"
 #include "../internal.hh"
 #include "../utils.hh"
@@ -6,9 +7,14 @@
 namespace whilelang {
     using namespace trieste;
 
-    PassDef constant_folding(std::shared_ptr<ControlFlow> cfg) {
+    PassDef constant_folding(
+        std::shared_ptr<ControlFlow> cfg,
+        bool demand_driven,
+        size_t call_string_depth) {
         auto analysis = std::make_shared<
-            DataFlowAnalysis<CPState, CPLatticeValue, CPImpl>>();
+            DataFlowAnalysis<CPState, CPLatticeValue, CPImpl>>(
+            cfg->get_arena());
+        auto query = std::make_shared<ConstantQuery>(cfg);
 
         auto fetch_instruction = [=](const Node &n) -> Node {
             auto curr = n;
@@ -28,7 +34,9 @@ namespace whilelang {
                 In(Atom) * T(Ident)[Ident] >> [=](Match &_) -> Node {
                     auto inst = fetch_instruction(_(Ident));
                     auto var = get_identifier(_(Ident));
-                    auto lattice_value = analysis->get_state(inst)[var];
+                    auto lattice_value = demand_driven
+                        ? query->value_at(inst, var)
+                        : analysis->get_state(inst)[var];
 
                     if (lattice_value.type == CPAbstractType::Constant) {
                         cfg->set_dirty_flag(true);
@@ -40,9 +48,15 @@ namespace whilelang {
             }};
 
         constant_folding.pre([=](Node) {
+            if (demand_driven) {
+                query->reset();
+                return 0;
+            }
+
             CPState first_state = cp_first_state(cfg);
 
-            analysis->forward_worklist_algoritm(cfg, first_state);
+            analysis->forward_call_string_algoritm(
+                cfg, first_state, call_string_depth);
 
             // cfg->log_instructions();
             // analysis->log_state_table(cfg);
@@ -50,6 +64,16 @@ namespace whilelang {
             return 0;
         });
 
+        constant_folding.post([=](Node) {
+            if (demand_driven) {
+                logging::Debug() << "Constant queries resolved "
+                                 << query->resolved_values() << " of "
+                                 << cfg->nodes_size() * cfg->get_vars().size()
+                                 << " values";
+            }
+            return 0;
+        });
+
         return constant_folding;
     }
 }
@@ -0,0 +1,131 @@
+#include "../analyses/available_copies.hh"
+#include "../analyses/dataflow_analysis.hh"
+#include "../internal.hh"
+#include "../utils.hh"
+
+namespace whilelang {
+    using namespace trieste;
+
+    using ACAnalysis =
+        DataFlowAnalysis<ACState, ACLatticeValue, ACImpl>;
+
+    void coalesce_count(
+        const Node &n,
+        std::map<std::string, int> &defs,
+        std::map<std::string, int> &uses) {
+        if (n == Assign) {
+            defs[get_identifier(n / Ident)]++;
+        } else if (n == Atom && n / Expr == Ident) {
+            uses[get_identifier(n / Expr)]++;
+        }
+
+        for (const auto &child : *n) {
+            coalesce_count(child, defs, uses);
+        }
+    }
+
+    PassDef copy_propagation(std::shared_ptr<ControlFlow> cfg) {
+        auto analysis = std::make_shared<ACAnalysis>(cfg->get_arena());
+        auto propagated = std::make_shared<size_t>(0);
+
+        auto fetch_instruction = [=](const Node &n) -> Node {
+            auto curr = n;
+
+            while (!curr->type().in(
+                {Assign, BExpr, FunCall, FunDef, Output, Return})) {
+                curr = curr->parent();
+            }
+            return curr;
+        };
+
+        // The copy of var available when the instruction is reached, the
+        // states of the table are the ones leaving each instruction
+        auto copy_source = [=](const Node &inst, const std::string &var) {
+            auto value = ACLatticeValue::bottom();
+
+            for (const auto &pred : cfg->predecessors(inst)) {
+                value = value.join(analysis->get_state(pred)[var]);
+            }
+            return value;
+        };
+
+        PassDef copy_propagation = {
+            "copy_propagation",
+            normalization_wf,
+            dir::bottomup | dir::once,
+            {
+                In(Atom) * T(Ident)[Ident] >> [=](Match &_) -> Node {
+                    auto inst = fetch_instruction(_(Ident));
+                    auto value = copy_source(inst, get_identifier(_(Ident)));
+
+                    if (value.type == ACAbstractType::Copy) {
+                        (*propagated)++;
+                        cfg->set_dirty_flag(true);
+                        return Ident ^ *value.source;
+                    }
+                    return NoChange;
+                },
+            }};
+
+        copy_propagation.pre([=](Node) {
+            *propagated = 0;
+
+            analysis->forward_worklist_algoritm(cfg, ac_first_state(cfg));
+
+            // cfg->log_instructions();
+            // analysis->log_state_table(cfg);
+
+            return 0;
+        });
+
+        copy_propagation.post([=](Node) {
+            logging::Debug() << "Copy propagation replaced " << *propagated
+                             << " uses";
+            return 0;
+        });
+
+        return copy_propagation;
+    }
+
+    PassDef coalesce_temporaries() {
+        auto defs = std::make_shared<std::map<std::string, int>>();
+        auto uses = std::make_shared<std::map<std::string, int>>();
+
+        PassDef coalesce_temporaries = {
+            "coalesce_temporaries",
+            normalization_wf,
+            dir::bottomup | dir::once,
+            {
+                // t := e; x := t
+                // becomes
+                // x := e
+                // when t is assigned and used nowhere else
+                In(Block) * (T(Stmt) << T(Assign)[Lhs]) *
+                        (T(Stmt)
+                         << (T(Assign)
+                             << (T(Ident)[Ident] *
+                                 (T(AExpr) << T(Atom)[Atom])))) >>
+                    [=](Match &_) -> Node {
+                    auto temp = get_identifier(_(Lhs) / Ident);
+                    auto source = _(Atom) / Expr;
+
+                    if (source != Ident || get_identifier(source) != temp ||
+                        (*defs)[temp] != 1 || (*uses)[temp] != 1) {
+                        return NoChange;
+                    }
+
+                    return Stmt << (Assign << _(Ident) << (_(Lhs) / Rhs));
+                },
+            }};
+
+        coalesce_temporaries.pre([=](Node n) {
+            defs->clear();
+            uses->clear();
+            coalesce_count(n, *defs, *uses);
+
+            return 0;
+        });
+
+        return coalesce_temporaries;
+    }
+}
@@ -1,5 +1,6 @@
 #include "../analyses/dataflow_analysis.hh"
 #include "../analyses/liveness.hh"
+#include "../analyses/side_effects.hh"
 #include "../internal.hh"
 #include "../utils.hh"
 
@@ -34,9 +35,20 @@ namespace whilelang {
 
     auto bool_to_bexpr = [](bool v) -> Node { return v ? True : False; };
 
+    Node dce_enclosing_function(Node n) {
+        while (n != FunDef) {
+            n = n->parent();
+        }
+        return n;
+    }
+
     PassDef dead_code_elimination(std::shared_ptr<ControlFlow> cfg) {
         auto analysis = std::make_shared<
-            DataFlowAnalysis<LiveState, std::string, LiveImpl>>();
+            DataFlowAnalysis<LiveState, std::string, LiveImpl>>(
+            cfg->get_arena());
+        auto side_effects = std::make_shared<SideEffects>();
+        // Functions whose return value is unused by every call
+        auto dead_returns = std::make_shared<NodeSet>();
 
         PassDef dead_code_elimination =
             {
@@ -44,32 +56,48 @@ namespace whilelang {
                 normalization_wf,
                 dir::bottomup | dir::once,
                 {
-                    // Remove unused functions
+                    // Remove functions which can not be reached from main,
+                    // including unreachable chains and cycles of calls
                     T(FunDef)[FunDef] >> [=](Match &_) -> Node {
-                        auto fun_id = (_(FunDef) / FunId) / Ident;
-
-                        if (get_identifier(fun_id) != "main" &&
-                            cfg->get_fun_calls_from_def(_(FunDef)).empty()) {
+                        if (!cfg->get_call_graph().is_reachable(_(FunDef))) {
                             return {};
                         }
                         return NoChange;
                     },
 
-                    // Remove unused variables
+                    // Remove unused variables, calls are only removed if
+                    // the called function has no side effects
                     T(Stmt)
                             << (T(Assign)[Assign]
                                 << (T(Ident)[Ident] * T(AExpr)[AExpr])) >>
                         [=](Match &_) -> Node {
                         auto id = get_identifier(_(Ident));
                         auto assign = _(Assign);
+                        auto expr = _(AExpr) / Expr;
 
                         if (analysis->get_state(assign).contains(id)) {
                             return NoChange;
+                        } else if (
+                            expr == FunCall &&
+                            !side_effects->is_pure(cfg->get_fun_def(expr))) {
+                            return NoChange;
                         } else {
                             return {};
                         }
                     },
 
+                    // Unused return values are replaced, which makes the
+                    // assignments computing them dead
+                    T(Return)[Return] << (T(Atom) << T(Ident)) >>
+                        [=](Match &_) -> Node {
+                        auto fun_def = dce_enclosing_function(_(Return));
+
+                        if (dead_returns->contains(fun_def)) {
+                            return Return << (Atom << create_const_node(0));
+                        }
+                        return NoChange;
+                    },
+
                     // Remove empty blocks
                     T(Stmt)[Stmt] << (T(Block)[Block] << End) >>
                         [](Match &_) -> Node {
@@ -151,6 +179,30 @@ namespace whilelang {
 
             analysis->backward_worklist_algoritm(cfg, first_state);
 
+            auto &call_graph = cfg->get_call_graph();
+            side_effects->compute(call_graph);
+
+            dead_returns->clear();
+            for (const auto &scc : call_graph.get_sccs()) {
+                for (const auto &fun_def : scc) {
+                    auto fun_calls = cfg->get_fun_calls_from_def(fun_def);
+                    bool unused = !fun_calls.empty();
+
+                    for (const auto &fun_call : fun_calls) {
+                        auto assign = fun_call->parent()->parent();
+                        auto var = get_identifier(assign / Ident);
+
+                        if (analysis->get_state(assign).contains(var)) {
+                            unused = false;
+                        }
+                    }
+
+                    if (unused) {
+                        dead_returns->insert(fun_def);
+                    }
+                }
+            }
+
             // cfg->log_instructions();
             // analysis->log_state_table(cfg);
 
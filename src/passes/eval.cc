@@ -1,8 +1,49 @@
+#include "../analyses/slot_allocation.hh"
 #include "../internal.hh"
 
 namespace whilelang {
     using namespace trieste;
-    using Bindings = std::shared_ptr<std::map<std::string, int>>;
+
+    // The values of the variables of a running function. Given a slot
+    // allocation, values are stored by slot like in a frame, so variables
+    // sharing a slot overwrite each other.
+    struct Frame {
+        std::map<std::string, int> values;
+        std::shared_ptr<SlotAllocation> slots;
+
+        Frame(std::shared_ptr<SlotAllocation> slots) : slots(slots) {}
+
+        std::string key(const std::string &var) const {
+            if (slots) {
+                if (auto slot = slots->get_slot(var)) {
+                    return "$" + std::to_string(*slot);
+                }
+            }
+            return var;
+        }
+
+        std::optional<int> get(const std::string &var) const {
+            auto res = values.find(key(var));
+            return res != values.end() ? std::optional(res->second)
+                                       : std::nullopt;
+        }
+
+        void set(const std::string &var, int value) {
+            values[key(var)] = value;
+        }
+    };
+    using Bindings = std::shared_ptr<Frame>;
+
+    // The functions of the program and the number of assignments, outputs,
+    // conditions and returns evaluated, including those in called functions
+    struct EvalContext {
+        std::map<std::string, Node> functions;
+        size_t executed = 0;
+        size_t multiplications = 0;
+    };
+    using Context = std::shared_ptr<EvalContext>;
+
+    int eval_call(Node call, Bindings bindings, Context ctx);
 
     std::string get_lexeme(Node n) {
         return std::string(n->location().view());
@@ -20,8 +61,8 @@ namespace whilelang {
         if (expr == Ident) {
             auto var = get_lexeme(expr);
 
-            if (bindings->find(var) != bindings->end())
-                return (*bindings)[var];
+            if (auto value = bindings->get(var))
+                return *value;
             else
                 throw std::runtime_error("Undefined variable: " + var);
         }
@@ -36,7 +77,7 @@ namespace whilelang {
         throw std::runtime_error("Invalid atom: " + expr->str());
     }
 
-    int eval_aexpr(Node n, Bindings bindings) {
+    int eval_aexpr(Node n, Bindings bindings, Context ctx) {
         if (n != AExpr)
             throw std::runtime_error(
                 "Not an arithmetic expression: " + n->str());
@@ -45,6 +86,9 @@ namespace whilelang {
         if (expr == Atom)
             return eval_atom(expr, bindings);
 
+        if (expr == FunCall)
+            return eval_call(expr, bindings, ctx);
+
         if (!expr->type().in({Add, Sub, Mul}))
             throw std::runtime_error(
                 "Invalid arithmetic expression: " + expr->str());
@@ -88,16 +132,100 @@ namespace whilelang {
         throw std::runtime_error("Invalid boolean expression");
     }
 
-    PassDef eval() {
-        auto bindings = std::make_shared<std::map<std::string, int>>();
+    void eval_assign(Node n, Bindings bindings, Context ctx) {
+        ctx->executed++;
+        auto rhs = n / Rhs;
+        if (rhs / Expr == Mul)
+            ctx->multiplications++;
+
+        auto value = eval_aexpr(rhs, bindings, ctx);
+        bindings->set(get_lexeme(n / Ident), value);
+    }
 
-        return {
+    // Runs a statement of a called function, returning the value of the
+    // return statement which ended it, if any
+    std::optional<int> eval_stmt(Node n, Bindings bindings, Context ctx) {
+        auto stmt = n / Stmt;
+
+        if (stmt == Block) {
+            for (auto &child : *stmt) {
+                if (auto res = eval_stmt(child, bindings, ctx))
+                    return res;
+            }
+        } else if (stmt == Assign) {
+            eval_assign(stmt, bindings, ctx);
+        } else if (stmt == Output) {
+            ctx->executed++;
+            std::cout << eval_atom(stmt->front(), bindings) << std::endl;
+        } else if (stmt == If) {
+            ctx->executed++;
+            auto branch = eval_bexpr(stmt / BExpr, bindings) ? stmt / Then
+                                                              : stmt / Else;
+            return eval_stmt(branch, bindings, ctx);
+        } else if (stmt == While) {
+            while (ctx->executed++, eval_bexpr(stmt / BExpr, bindings)) {
+                if (auto res = eval_stmt(stmt / Do, bindings, ctx))
+                    return res;
+            }
+        } else if (stmt == Return) {
+            ctx->executed++;
+            return eval_atom(stmt->front(), bindings);
+        } else if (stmt != Skip) {
+            throw std::runtime_error("Invalid statement: " + stmt->str());
+        }
+        return std::nullopt;
+    }
+
+    // Called functions run to completion with their own bindings, holding
+    // only the parameters when the call starts
+    int eval_call(Node call, Bindings bindings, Context ctx) {
+        auto name = get_lexeme((call / FunId) / Ident);
+        auto fun_def = ctx->functions.find(name);
+        if (fun_def == ctx->functions.end())
+            throw std::runtime_error("Undefined function: " + name);
+
+        auto params = fun_def->second / ParamList;
+        auto args = call / ArgList;
+        if (params->size() != args->size())
+            throw std::runtime_error("Wrong number of arguments to " + name);
+
+        auto locals = std::make_shared<Frame>(bindings->slots);
+        for (size_t i = 0; i < params->size(); i++) {
+            auto param = get_lexeme(params->at(i) / Ident);
+            locals->set(param, eval_atom(args->at(i)->front(), bindings));
+        }
+
+        if (auto res = eval_stmt(fun_def->second / Body, locals, ctx))
+            return *res;
+        throw std::runtime_error("Function " + name + " did not return");
+    }
+
+    PassDef eval(std::shared_ptr<SlotAllocation> slots) {
+        auto bindings = std::make_shared<Frame>(slots);
+        auto ctx = std::make_shared<EvalContext>();
+
+        PassDef eval = {
             "eval",
             eval_wf,
             dir::topdown,
             {T(Program) << T(Stmt)[Stmt] >>
                  [](Match &_) -> Node { return Eval << _(Stmt); },
 
+             // Programs are executed from the body of main
+             T(Program)[Program] << T(FunDef) >> [ctx](Match &_) -> Node {
+                 for (auto fun_def : *_(Program)) {
+                     auto name = get_lexeme((fun_def / FunId) / Ident);
+                     ctx->functions.insert({name, fun_def});
+                 }
+
+                 auto main = ctx->functions.find("main");
+                 if (main != ctx->functions.end()) {
+                     return Eval << (main->second / Body)->clone();
+                 }
+                 return Error << (ErrorAst << _(Program))
+                              << (ErrorMsg ^ "No main function found");
+             },
+
              In(Eval) * T(Stmt) << T(Block)[Block] >>
                  [](Match &_) -> Node { return Seq << *_[Block]; },
 
@@ -105,16 +233,15 @@ namespace whilelang {
                  [](Match &) -> Node { return {}; },
 
              In(Eval) * T(Stmt)
-                     << (T(Assign) << (T(Ident)[Ident] * T(AExpr)[Rhs])) >>
-                 [bindings](Match &_) -> Node {
-                 auto var = get_lexeme(_(Ident));
-                 auto rhs = _(Rhs);
-                 (*bindings)[var] = eval_aexpr(rhs, bindings);
+                     << (T(Assign)[Assign] << (T(Ident) * T(AExpr))) >>
+                 [bindings, ctx](Match &_) -> Node {
+                 eval_assign(_(Assign), bindings, ctx);
                  return {};
              },
 
              In(Eval) * T(Stmt) << (T(Output) << T(Atom)[Expr]) >>
-                 [bindings](Match &_) -> Node {
+                 [bindings, ctx](Match &_) -> Node {
+                 ctx->executed++;
                  auto expr = _(Expr);
                  int result = eval_atom(expr, bindings);
                  std::cout << result << std::endl;
@@ -125,7 +252,8 @@ namespace whilelang {
                      << (T(If)
                          << (T(BExpr)[BExpr] * T(Stmt)[Then] *
                              T(Stmt)[Else])) >>
-                 [bindings](Match &_) -> Node {
+                 [bindings, ctx](Match &_) -> Node {
+                 ctx->executed++;
                  auto cond = _(BExpr);
                  auto then = _(Then);
                  auto else_ = _(Else);
@@ -136,7 +264,8 @@ namespace whilelang {
 
              In(Eval) * T(Stmt)[While]
                      << (T(While) << (T(BExpr)[BExpr] * T(Stmt)[Do])) >>
-                 [bindings](Match &_) -> Node {
+                 [bindings, ctx](Match &_) -> Node {
+                 ctx->executed++;
                  auto while_ = _(While);
                  auto cond = _(BExpr);
                  auto body = _(Do);
@@ -149,12 +278,29 @@ namespace whilelang {
                  }
              },
 
+             // Returning from main ends the program
+             In(Eval) * (T(Stmt) << (T(Return) << T(Atom)[Expr])) * Any++ >>
+                 [bindings, ctx](Match &_) -> Node {
+                 ctx->executed++;
+                 eval_atom(_(Expr), bindings);
+                 return {};
+             },
+
              In(Eval) << Any[Stmt] >> [](Match &_) -> Node {
                  return Error << (ErrorAst << _(Stmt))
                               << (ErrorMsg ^ "Could not evaluate statement");
              },
 
              T(Eval) << End >> [](Match &) -> Node { return {}; }}};
+
+        eval.post([ctx](Node) {
+            logging::Debug() << "EXECUTED INSTRUCTIONS: " << ctx->executed;
+            logging::Debug() << "EXECUTED MULTIPLICATIONS: "
+                             << ctx->multiplications;
+            return 0;
+        });
+
+        return eval;
     }
 
 }
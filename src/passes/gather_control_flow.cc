@@ -179,10 +179,185 @@ namespace whilelang {
                 },
             }};
         gather_flow_graph.post([=](Node) {
+            cfg->finalize();
             cfg->set_dirty_flag(false);
             return 0;
         });
 
         return gather_flow_graph;
     }
+
+    // Entry node and exit nodes of a statement in the flow graph
+    struct FlowFragment {
+        Node entry;
+        NodeSet exits;
+    };
+
+    // Builds instructions, variables, calls and edges in one traversal of the
+    // AST. The entry and exits of every statement are computed once, bottom
+    // up, instead of being searched for at each pair of statements.
+    class FlowGraphBuilder {
+      public:
+        FlowGraphBuilder(std::shared_ptr<ControlFlow> cfg) : cfg(cfg) {}
+
+        void program(const Node &program) {
+            for (const auto &fun_def : *program) {
+                function(fun_def);
+            }
+
+            cfg->set_functions_calls(fun_defs, fun_calls);
+
+            // Calls and returns can only be connected once every function
+            // has been seen
+            for (const auto &fun_call : *fun_calls) {
+                auto fun_def = cfg->get_fun_def(fun_call);
+                if (fun_def) {
+                    cfg->add_edge(fun_call, fun_def);
+                }
+            }
+
+            for (const auto &[ret, fun_def] : returns) {
+                for (auto fun_call : cfg->get_fun_calls_from_def(fun_def)) {
+                    auto assign = fun_call->parent()->parent();
+                    if (assign != Assign) {
+                        throw std::runtime_error(
+                            "Invalid function call, expected assignment as "
+                            "parent");
+                    }
+                    cfg->add_edge(ret, assign);
+                }
+            }
+        }
+
+      private:
+        std::shared_ptr<ControlFlow> cfg;
+        std::shared_ptr<NodeSet> fun_defs = std::make_shared<NodeSet>();
+        std::shared_ptr<NodeSet> fun_calls = std::make_shared<NodeSet>();
+        std::vector<std::pair<Node, Node>> returns;
+        Node curr_fun_def;
+
+        void function(const Node &fun_def) {
+            curr_fun_def = fun_def;
+            fun_defs->insert(fun_def);
+            cfg->add_instruction(fun_def);
+
+            for (const auto &param : *(fun_def / ParamList)) {
+                cfg->add_var(param / Ident);
+            }
+
+            auto body = stmt(fun_def / Body);
+            cfg->add_edge(fun_def, body.entry);
+        }
+
+        FlowFragment stmt(const Node &n) {
+            auto s = n / Stmt;
+
+            if (s == Block) {
+                auto first = stmt(s->front());
+                auto prev_exits = first.exits;
+
+                for (size_t i = 1; i < s->size(); i++) {
+                    auto next = stmt(s->at(i));
+                    cfg->add_edge(prev_exits, next.entry);
+
+                    // The assignment of a call result also flows from the
+                    // preceding statement
+                    auto next_s = s->at(i) / Stmt;
+                    if (next_s == Assign &&
+                        (next_s / Rhs) / Expr == FunCall) {
+                        cfg->add_edge(prev_exits, next_s);
+                    }
+                    prev_exits = std::move(next.exits);
+                }
+                return {first.entry, prev_exits};
+            } else if (s == While) {
+                auto b_expr = s / BExpr;
+                cfg->add_instruction(b_expr);
+                vars(b_expr);
+
+                auto body = stmt(s / Do);
+                cfg->add_edge(body.exits, b_expr);
+                cfg->add_edge(b_expr, body.entry);
+
+                return {b_expr, {b_expr}};
+            } else if (s == If) {
+                auto b_expr = s / BExpr;
+                cfg->add_instruction(b_expr);
+                vars(b_expr);
+
+                auto then_stmt = stmt(s / Then);
+                auto else_stmt = stmt(s / Else);
+                cfg->add_edge(b_expr, then_stmt.entry);
+                cfg->add_edge(b_expr, else_stmt.entry);
+
+                auto exits = std::move(then_stmt.exits);
+                exits.insert(else_stmt.exits.begin(), else_stmt.exits.end());
+                return {b_expr, exits};
+            } else if (s == Assign && (s / Rhs) / Expr == FunCall) {
+                auto fun_call = (s / Rhs) / Expr;
+                fun_calls->insert(fun_call);
+                cfg->add_instruction(fun_call);
+                cfg->add_var(s / Ident);
+                vars(fun_call / ArgList);
+
+                return {fun_call, {s}};
+            }
+
+            cfg->add_instruction(s);
+            if (s == Assign) {
+                cfg->add_var(s / Ident);
+            } else if (s == Return) {
+                returns.push_back({s, curr_fun_def});
+            }
+            vars(s);
+
+            return {s, {s}};
+        }
+
+        // Gathers the variables used inside of an expression
+        void vars(const Node &n) {
+            if (n == Atom) {
+                if ((n / Expr) == Ident) {
+                    cfg->add_var(n / Expr);
+                }
+                return;
+            }
+
+            for (const auto &child : *n) {
+                vars(child);
+            }
+        }
+    };
+
+    PassDef build_control_flow(std::shared_ptr<ControlFlow> cfg) {
+        PassDef build_control_flow = {
+            "build_control_flow",
+            normalization_wf,
+            dir::topdown | dir::once,
+            {
+                T(Program)[Program] >> [=](Match &_) -> Node {
+                    FlowGraphBuilder(cfg).program(_(Program));
+                    return NoChange;
+                },
+            }};
+
+        build_control_flow.pre([=](Node) {
+            if (cfg->is_dirty()) {
+                cfg->clear();
+            }
+            return 0;
+        });
+
+        build_control_flow.post([=](Node) {
+            if (cfg->get_instructions().empty()) {
+                throw std::runtime_error("Unexpected, missing instructions");
+            }
+
+            cfg->finalize();
+            cfg->set_dirty_flag(false);
+            return 0;
+        });
+
+        return build_control_flow;
+    }
 }
@@ -0,0 +1,220 @@
+#include "../internal.hh"
+#include "../utils.hh"
+
+namespace whilelang {
+    using namespace trieste;
+
+    // Operation and the value numbers of its operands
+    using ExprKey = std::tuple<std::string, size_t, size_t>;
+
+    // Value numbers of one function. Expressions map to the same number
+    // whenever their operands have the same numbers, and every number keeps
+    // track of the variables currently holding it. Changes to variables are
+    // logged so that the state can be rolled back after a branch.
+    class ValueTable {
+      public:
+        size_t atom(const Node &atom) {
+            auto expr = atom / Expr;
+
+            if (expr == Int) {
+                auto [it, _] =
+                    const_values.try_emplace(get_int_value(expr), next_value);
+                if (it->second == next_value) {
+                    next_value++;
+                }
+                return it->second;
+            } else if (expr == Ident) {
+                auto var = get_identifier(expr);
+                auto res = var_values.find(var);
+
+                if (res != var_values.end()) {
+                    return res->second;
+                }
+                // Parameters and variables without a visible definition
+                auto value = next_value++;
+                set_value(var, value);
+                return value;
+            }
+
+            // Every input is a new value
+            return next_value++;
+        }
+
+        size_t expr(const Node &op) {
+            auto lhs = op / Lhs;
+            auto rhs = op / Rhs;
+
+            if (lhs / Expr == Input || rhs / Expr == Input) {
+                return next_value++;
+            }
+
+            auto lhs_value = atom(lhs);
+            auto rhs_value = atom(rhs);
+
+            // Operands of commutative operations are ordered
+            if (op->type().in({Add, Mul}) && rhs_value < lhs_value) {
+                std::swap(lhs_value, rhs_value);
+            }
+
+            ExprKey key = {std::string(op->type().str()), lhs_value, rhs_value};
+            auto [it, _] = expr_values.try_emplace(key, next_value);
+            if (it->second == next_value) {
+                next_value++;
+            }
+            return it->second;
+        }
+
+        size_t fresh() {
+            return next_value++;
+        }
+
+        // A variable holding the value, preferring the given variable
+        std::optional<std::string>
+        holder(size_t value, const std::string &preferred) {
+            auto res = holders.find(value);
+
+            if (res == holders.end() || res->second.empty()) {
+                return std::nullopt;
+            } else if (res->second.contains(preferred)) {
+                return preferred;
+            }
+            return *res->second.begin();
+        }
+
+        void set_value(const std::string &var, size_t value) {
+            auto res = var_values.find(var);
+            std::optional<size_t> old_value;
+
+            if (res != var_values.end()) {
+                old_value = res->second;
+                holders[res->second].erase(var);
+            }
+
+            log.push_back({var, old_value});
+            var_values[var] = value;
+            holders[value].insert(var);
+        }
+
+        void kill(const std::set<std::string> &vars) {
+            for (const auto &var : vars) {
+                set_value(var, next_value++);
+            }
+        }
+
+        size_t checkpoint() {
+            return log.size();
+        }
+
+        void rollback(size_t checkpoint) {
+            while (log.size() > checkpoint) {
+                auto [var, old_value] = log.back();
+                log.pop_back();
+
+                holders[var_values[var]].erase(var);
+                if (old_value) {
+                    var_values[var] = *old_value;
+                    holders[*old_value].insert(var);
+                } else {
+                    var_values.erase(var);
+                }
+            }
+        }
+
+      private:
+        size_t next_value = 0;
+        std::map<std::string, size_t> var_values;
+        std::map<int, size_t> const_values;
+        std::map<ExprKey, size_t> expr_values;
+        std::map<size_t, std::set<std::string>> holders;
+        std::vector<std::pair<std::string, std::optional<size_t>>> log;
+    };
+
+    // Finds assignments recomputing a value which some variable already
+    // holds, mapping them to that variable
+    void gvn_stmt(
+        const Node &stmt,
+        ValueTable &table,
+        std::shared_ptr<NodeMap<std::string>> replacements) {
+        auto s = stmt / Stmt;
+
+        if (s == Block) {
+            for (const auto &child : *s) {
+                gvn_stmt(child, table, replacements);
+            }
+        } else if (s == Assign) {
+            auto var = get_identifier(s / Ident);
+            auto expr = (s / Rhs) / Expr;
+
+            if (expr == Atom) {
+                table.set_value(var, table.atom(expr));
+            } else if (expr->type().in({Add, Sub, Mul})) {
+                auto value = table.expr(expr);
+
+                if (auto holder = table.holder(value, var)) {
+                    replacements->insert({s, *holder});
+                }
+                table.set_value(var, value);
+            } else {
+                table.set_value(var, table.fresh());
+            }
+        } else if (s == If) {
+            // Values computed in a branch are only available inside of it
+            auto checkpoint = table.checkpoint();
+            gvn_stmt(s / Then, table, replacements);
+            table.rollback(checkpoint);
+            gvn_stmt(s / Else, table, replacements);
+            table.rollback(checkpoint);
+
+            table.kill(get_assigned_vars(s));
+        } else if (s == While) {
+            // Only values not changed by the loop are available in it
+            table.kill(get_assigned_vars(s / Do));
+
+            auto checkpoint = table.checkpoint();
+            gvn_stmt(s / Do, table, replacements);
+            table.rollback(checkpoint);
+        }
+    }
+
+    PassDef global_value_numbering() {
+        auto replacements = std::make_shared<NodeMap<std::string>>();
+
+        PassDef global_value_numbering = {
+            "global_value_numbering",
+            normalization_wf,
+            dir::bottomup | dir::once,
+            {
+                T(Assign)[Assign] << T(Ident)[Ident] >> [=](Match &_) -> Node {
+                    auto res = replacements->find(_(Assign));
+                    if (res == replacements->end()) {
+                        return NoChange;
+                    }
+
+                    // The variable already holds the value
+                    if (res->second == get_identifier(_(Ident))) {
+                        return Skip;
+                    }
+                    return Assign << _(Ident)
+                                  << (AExpr << (Atom << (Ident ^ res->second)));
+                },
+            }};
+
+        global_value_numbering.pre([=](Node n) {
+            replacements->clear();
+
+            for (const auto &fun_def : *(n / Program)) {
+                ValueTable table;
+                gvn_stmt(fun_def / Body, table, replacements);
+            }
+            return 0;
+        });
+
+        global_value_numbering.post([=](Node) {
+            logging::Debug() << "GVN replaced " << replacements->size()
+                             << " recomputed expressions";
+            return 0;
+        });
+
+        return global_value_numbering;
+    }
+}
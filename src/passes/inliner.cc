@@ -0,0 +1,198 @@
+#include "../call_graph.hh"
+#include "../internal.hh"
+#include "../utils.hh"
+
+namespace whilelang {
+    using namespace trieste;
+
+    // Extra benefit given for each argument which is a constant, as
+    // constant folding can then simplify the inlined body
+    const int INLINE_CONSTANT_ARG_BONUS = 2;
+
+    void inline_gather_functions(
+        const Node &n, NodeSet &fun_defs, NodeSet &fun_calls, Nodes &calls) {
+        if (n == FunDef) {
+            fun_defs.insert(n);
+        } else if (n == FunCall) {
+            fun_calls.insert(n);
+            calls.push_back(n);
+        }
+
+        for (const auto &child : *n) {
+            inline_gather_functions(child, fun_defs, fun_calls, calls);
+        }
+    }
+
+    // Number of basic statements and conditions
+    int inline_size(const Node &n) {
+        if (n->type().in({Assign, Output, Return, Skip, BExpr})) {
+            return 1;
+        }
+
+        int size = 0;
+        for (const auto &child : *n) {
+            size += inline_size(child);
+        }
+        return size;
+    }
+
+    // Every return must end the execution of the function body, so that it
+    // can be replaced with an assignment without jumping past other code
+    bool inline_tail_returns(const Node &stmt, bool tail) {
+        auto s = stmt / Stmt;
+
+        if (s == Return) {
+            return tail;
+        } else if (s == Block) {
+            for (size_t i = 0; i < s->size(); i++) {
+                if (!inline_tail_returns(s->at(i), tail && i == s->size() - 1)) {
+                    return false;
+                }
+            }
+        } else if (s == If) {
+            return inline_tail_returns(s / Then, tail) &&
+                inline_tail_returns(s / Else, tail);
+        } else if (s == While) {
+            return inline_tail_returns(s / Do, false);
+        }
+        return true;
+    }
+
+    // Renames every variable of the copied body and turns returns into
+    // assignments to the target of the call
+    void inline_rename(
+        const Node &n,
+        std::map<std::string, std::string> &names,
+        const Node &target,
+        const Node &fresh_source) {
+        for (auto &child : *n) {
+            if (child == Ident) {
+                auto name = get_identifier(child);
+                auto res = names.find(name);
+
+                if (res == names.end()) {
+                    auto fresh = std::string(fresh_source->fresh().view());
+                    res = names.insert({name, fresh}).first;
+                }
+                n->replace(child, Ident ^ res->second);
+            } else if (child == Return) {
+                inline_rename(child, names, target, fresh_source);
+                n->replace(
+                    child,
+                    Assign << target->clone() << (AExpr << (child / Atom)));
+            } else if (child != FunId) {
+                inline_rename(child, names, target, fresh_source);
+            }
+        }
+    }
+
+    PassDef inline_functions(int threshold, int budget) {
+        auto inline_calls = std::make_shared<NodeMap<Node>>();
+
+        PassDef inline_functions = {
+            "inline_functions",
+            normalization_wf,
+            dir::bottomup | dir::once,
+            {
+                // x := f(a1, ..., an)
+                // becomes
+                // { p1' := a1; ...; pn' := an; body' }
+                // where body' is a copy of the body of f with fresh variable
+                // names and return a replaced by x := a
+                T(Stmt)
+                        << (T(Assign)[Assign]
+                            << (T(Ident)[Ident] *
+                                (T(AExpr) << T(FunCall)[FunCall]))) >>
+                    [=](Match &_) -> Node {
+                    auto res = inline_calls->find(_(FunCall));
+                    if (res == inline_calls->end()) {
+                        return NoChange;
+                    }
+
+                    auto callee = res->second;
+                    auto params = callee / ParamList;
+                    auto args = _(FunCall) / ArgList;
+                    std::map<std::string, std::string> names;
+                    Node block = Block;
+
+                    for (size_t i = 0; i < params->size(); i++) {
+                        auto param = get_identifier(params->at(i) / Ident);
+                        auto fresh = std::string(_(Assign)->fresh().view());
+                        names.insert({param, fresh});
+
+                        block
+                            << (Stmt
+                                << (Assign
+                                    << (Ident ^ fresh)
+                                    << (AExpr << (args->at(i) / Atom)->clone())));
+                    }
+
+                    auto body = (callee / Body)->clone();
+                    inline_rename(body, names, _(Ident), _(Assign));
+                    block << body;
+
+                    return Stmt << block;
+                },
+            }};
+
+        inline_functions.pre([=](Node n) {
+            inline_calls->clear();
+
+            NodeSet fun_defs;
+            NodeSet fun_calls;
+            Nodes calls;
+            inline_gather_functions(n, fun_defs, fun_calls, calls);
+
+            CallGraph call_graph;
+            call_graph.build(fun_defs, fun_calls);
+
+            std::map<std::string, int> call_counts;
+            for (const auto &fun_call : calls) {
+                call_counts[get_identifier((fun_call / FunId) / Ident)]++;
+            }
+
+            int growth = 0;
+            for (const auto &fun_call : calls) {
+                auto name = get_identifier((fun_call / FunId) / Ident);
+                auto callee = call_graph.get_fun_def(name);
+
+                if (!callee || name == "main" ||
+                    call_graph.is_recursive(callee) ||
+                    (callee / ParamList)->size() !=
+                        (fun_call / ArgList)->size() ||
+                    !inline_tail_returns(callee / Body, true)) {
+                    continue;
+                }
+
+                // Inlining removes the call and the binding of the
+                // parameters, and the callee itself once its only call is
+                // inlined
+                int size = inline_size(callee / Body);
+                int benefit = 1 + (callee / ParamList)->size();
+
+                for (const auto &arg : *(fun_call / ArgList)) {
+                    if ((arg / Atom) / Expr == Int) {
+                        benefit += INLINE_CONSTANT_ARG_BONUS;
+                    }
+                }
+                if (call_counts[name] == 1) {
+                    benefit += size;
+                }
+
+                if (size - benefit <= threshold && growth + size <= budget) {
+                    growth += size;
+                    inline_calls->insert({fun_call, callee});
+                }
+            }
+
+            return 0;
+        });
+
+        inline_functions.post([=](Node) {
+            logging::Debug() << "Inlined " << inline_calls->size() << " calls";
+            return 0;
+        });
+
+        return inline_functions;
+    }
+}
@@ -0,0 +1,246 @@
+#include "../analyses/dataflow_analysis.hh"
+#include "../analyses/reaching_definitions.hh"
+#include "../internal.hh"
+#include "../utils.hh"
+
+namespace whilelang {
+    using namespace trieste;
+
+    using RDAnalysis =
+        DataFlowAnalysis<RDState, std::pmr::set<Node>, RDImpl>;
+
+    bool licm_contains(const Node &n, const Token &type) {
+        if (n == type) {
+            return true;
+        }
+
+        for (const auto &child : *n) {
+            if (licm_contains(child, type)) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    bool licm_inside(Node n, const Node &loop) {
+        while (n && n != FunDef) {
+            if (n == loop) {
+                return true;
+            }
+            n = n->parent();
+        }
+        return false;
+    }
+
+    void licm_count_assigns(const Node &n, std::map<std::string, int> &count) {
+        if (n == Assign) {
+            count[get_identifier(n / Ident)]++;
+        }
+
+        for (const auto &child : *n) {
+            licm_count_assigns(child, count);
+        }
+    }
+
+    void licm_used_vars(const Node &n, Vars &vars) {
+        if (n == Atom) {
+            if (n / Expr == Ident) {
+                vars.insert(get_identifier(n / Expr));
+            }
+            return;
+        }
+
+        for (const auto &child : *n) {
+            licm_used_vars(child, vars);
+        }
+    }
+
+    // Definitions of the variable reaching the start of the instruction
+    NodeSet licm_reaching(
+        std::shared_ptr<ControlFlow> cfg,
+        std::shared_ptr<RDAnalysis> analysis,
+        const Node &inst,
+        const std::string &var) {
+        NodeSet defs;
+
+        for (const auto &pred : cfg->predecessors(inst)) {
+            const auto &state = analysis->get_state(pred);
+            auto res = state.find(var);
+
+            if (res != state.end()) {
+                defs.insert(res->second.begin(), res->second.end());
+            }
+        }
+        return defs;
+    }
+
+    // Finds the assignments which can be executed once before the loop.
+    // Only statements at the top level of the body are considered, as they
+    // execute in every iteration, and the loop is guarded so that the body
+    // runs at least once. An assignment x := e is hoisted when
+    //   - every operand of e is only defined outside of the loop or by an
+    //     assignment hoisted before it,
+    //   - it is the only assignment to x in the loop, and
+    //   - every use of x in the loop is only reached by it.
+    NodeSet licm_invariants(
+        std::shared_ptr<ControlFlow> cfg,
+        std::shared_ptr<RDAnalysis> analysis,
+        const Node &loop) {
+        NodeSet hoisted;
+        auto bexpr = loop / BExpr;
+        auto body = (loop / Do) / Stmt;
+
+        // The guard evaluates the condition once more, and returning from
+        // the body leaves the loop without passing its condition
+        if (licm_contains(bexpr, Input) || licm_contains(body, Return)) {
+            return hoisted;
+        }
+
+        std::map<std::string, int> assign_count;
+        licm_count_assigns(body, assign_count);
+
+        std::map<std::string, Nodes> uses;
+        for (const auto &inst : cfg->get_loop_instructions(loop)) {
+            Vars used;
+            licm_used_vars(inst, used);
+
+            for (const auto &var : used) {
+                uses[var].push_back(inst);
+            }
+        }
+
+        Nodes top_level;
+        if (body == Block) {
+            for (const auto &stmt : *body) {
+                top_level.push_back(stmt / Stmt);
+            }
+        } else {
+            top_level.push_back(body);
+        }
+
+        for (const auto &assign : top_level) {
+            if (assign != Assign) {
+                continue;
+            }
+
+            auto var = get_identifier(assign / Ident);
+            auto expr = (assign / Rhs) / Expr;
+            if (expr == FunCall || assign_count[var] != 1) {
+                continue;
+            }
+
+            Nodes operands;
+            if (expr == Atom) {
+                operands.push_back(expr);
+            } else {
+                operands.push_back(expr / Lhs);
+                operands.push_back(expr / Rhs);
+            }
+
+            bool invariant = true;
+            for (const auto &atom : operands) {
+                auto operand = atom / Expr;
+
+                if (operand == Input) {
+                    invariant = false;
+                } else if (operand == Ident) {
+                    auto defs = licm_reaching(
+                        cfg, analysis, assign, get_identifier(operand));
+
+                    for (const auto &def : defs) {
+                        if (licm_inside(def, loop) && !hoisted.contains(def)) {
+                            invariant = false;
+                        }
+                    }
+                }
+            }
+
+            for (const auto &use : uses[var]) {
+                auto defs = licm_reaching(cfg, analysis, use, var);
+                if (defs.size() != 1 || !defs.contains(assign)) {
+                    invariant = false;
+                }
+            }
+
+            if (invariant) {
+                hoisted.insert(assign);
+            }
+        }
+        return hoisted;
+    }
+
+    PassDef loop_invariant_code_motion(std::shared_ptr<ControlFlow> cfg) {
+        auto analysis = std::make_shared<RDAnalysis>(cfg->get_arena());
+        auto hoists = std::make_shared<NodeMap<NodeSet>>();
+
+        PassDef loop_invariant_code_motion = {
+            "loop_invariant_code_motion",
+            normalization_wf,
+            dir::bottomup | dir::once,
+            {
+                // while c do body
+                // becomes
+                // if c then { hoisted; while c do body' } else { skip }
+                T(Stmt) << T(While)[While] >> [=](Match &_) -> Node {
+                    auto loop = _(While);
+                    auto res = hoists->find(loop);
+                    if (res == hoists->end()) {
+                        return NoChange;
+                    }
+
+                    auto bexpr = loop / BExpr;
+                    auto body = (loop / Do) / Stmt;
+                    Node preheader = Block;
+                    Node new_body = Block;
+
+                    if (body == Block) {
+                        for (const auto &stmt : *body) {
+                            if (res->second.contains(stmt / Stmt)) {
+                                preheader << stmt;
+                            } else {
+                                new_body << stmt;
+                            }
+                        }
+                    } else {
+                        preheader << (loop / Do);
+                    }
+
+                    if (new_body->empty()) {
+                        new_body << (Stmt << Skip);
+                    }
+
+                    preheader
+                        << (Stmt
+                            << (While << bexpr->clone() << (Stmt << new_body)));
+
+                    cfg->set_dirty_flag(true);
+                    return Stmt
+                        << (If << bexpr << (Stmt << preheader)
+                               << (Stmt << (Block << (Stmt << Skip))));
+                },
+            }};
+
+        loop_invariant_code_motion.pre([=](Node) {
+            hoists->clear();
+
+            auto first_state = RDImpl::create_state(
+                cfg->get_vars(), cfg->get_arena()->resource());
+            analysis->forward_worklist_algoritm(cfg, first_state);
+
+            size_t count = 0;
+            for (const auto &loop : cfg->get_loops()) {
+                auto hoisted = licm_invariants(cfg, analysis, loop);
+
+                if (!hoisted.empty()) {
+                    count += hoisted.size();
+                    hoists->insert({loop, hoisted});
+                }
+            }
+
+            logging::Debug() << "LICM hoisted " << count << " assignments";
+            return 0;
+        });
+
+        return loop_invariant_code_motion;
+    }
+}
@@ -0,0 +1,265 @@
+#include "../analyses/constant_propagation.hh"
+#include "../analyses/dataflow_analysis.hh"
+#include "../analyses/induction_variables.hh"
+#include "../internal.hh"
+#include "../utils.hh"
+
+namespace whilelang {
+    using namespace trieste;
+
+    using CPAnalysis = DataFlowAnalysis<CPState, CPLatticeValue, CPImpl>;
+
+    // Copies of the body run before the loop and in each iteration. A fully
+    // unrolled loop has no iterations left.
+    struct UnrollPlan {
+        size_t prologue;
+        size_t factor;
+        bool full;
+    };
+
+    bool unroll_inside(Node n, const Node &loop) {
+        while (n && n != FunDef) {
+            if (n == loop) {
+                return true;
+            }
+            n = n->parent();
+        }
+        return false;
+    }
+
+    // Number of basic statements and conditions
+    size_t unroll_size(const Node &n) {
+        if (n->type().in({Assign, Output, Return, Skip, BExpr})) {
+            return 1;
+        }
+
+        size_t size = 0;
+        for (const auto &child : *n) {
+            size += unroll_size(child);
+        }
+        return size;
+    }
+
+    // Whether an assignment other than the update assigns the variable
+    bool unroll_other_assign(
+        const Node &n, const std::string &var, const Node &update) {
+        if (n == Assign && n != update && get_identifier(n / Ident) == var) {
+            return true;
+        }
+
+        for (const auto &child : *n) {
+            if (unroll_other_assign(child, var, update)) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    // The constant value of the atom when the loop is entered from outside
+    std::optional<int> unroll_entry_value(
+        std::shared_ptr<ControlFlow> cfg,
+        std::shared_ptr<CPAnalysis> analysis,
+        const Node &loop,
+        const Node &atom) {
+        auto expr = atom / Expr;
+        if (expr == Int) {
+            return get_int_value(expr);
+        } else if (expr != Ident) {
+            return std::nullopt;
+        }
+
+        auto var = get_identifier(expr);
+        auto value = CPLatticeValue::bottom();
+        for (const auto &pred : cfg->predecessors(loop / BExpr)) {
+            if (!unroll_inside(pred, loop)) {
+                value = value.join(analysis->get_state(pred)[var]);
+            }
+        }
+
+        if (value.type != CPAbstractType::Constant) {
+            return std::nullopt;
+        }
+        return value.value;
+    }
+
+    // Number of iterations of a loop i < n or n < i, where i is a basic
+    // induction variable updated once in every iteration and n is not
+    // changed by the loop
+    std::optional<long long> unroll_trip_count(
+        std::shared_ptr<ControlFlow> cfg,
+        std::shared_ptr<CPAnalysis> analysis,
+        InductionVariables &induction,
+        const Node &loop) {
+        auto cond = (loop / BExpr) / Expr;
+        if (cond != LT) {
+            return std::nullopt;
+        }
+
+        const auto &basic = induction.get_basic(loop);
+        auto find_basic = [&](const Node &atom) -> const BasicInduction * {
+            if (atom / Expr != Ident) {
+                return nullptr;
+            }
+            auto res = basic.find(get_identifier(atom / Expr));
+            return res != basic.end() ? &res->second : nullptr;
+        };
+
+        auto lhs = cond / Lhs;
+        auto rhs = cond / Rhs;
+        auto lhs_basic = find_basic(lhs);
+        auto rhs_basic = find_basic(rhs);
+
+        Node var;
+        Node bound;
+        const BasicInduction *induction_var;
+        if (lhs_basic && !rhs_basic && lhs_basic->step > 0) {
+            var = lhs;
+            bound = rhs;
+            induction_var = lhs_basic;
+        } else if (rhs_basic && !lhs_basic && rhs_basic->step < 0) {
+            var = rhs;
+            bound = lhs;
+            induction_var = rhs_basic;
+        } else {
+            return std::nullopt;
+        }
+
+        // The update must run exactly once in every iteration
+        auto body = (loop / Do) / Stmt;
+        auto update_block = induction_var->update->parent()->parent();
+        if (body != Block || update_block != body ||
+            unroll_other_assign(
+                loop / Do, get_identifier(var / Expr), induction_var->update)) {
+            return std::nullopt;
+        }
+
+        if (bound / Expr == Ident &&
+            get_assigned_vars(loop / Do).contains(
+                get_identifier(bound / Expr))) {
+            return std::nullopt;
+        }
+
+        auto start = unroll_entry_value(cfg, analysis, loop, var);
+        auto end = unroll_entry_value(cfg, analysis, loop, bound);
+        if (!start || !end) {
+            return std::nullopt;
+        }
+
+        long long step = induction_var->step;
+        long long distance = step > 0 ? (long long)*end - *start
+                                      : (long long)*start - *end;
+        if (distance <= 0) {
+            return 0;
+        }
+
+        step = step > 0 ? step : -step;
+        return (distance + step - 1) / step;
+    }
+
+    PassDef loop_unrolling(
+        std::shared_ptr<ControlFlow> cfg, size_t budget, size_t factor) {
+        auto analysis = std::make_shared<CPAnalysis>(cfg->get_arena());
+        auto induction = std::make_shared<InductionVariables>(cfg);
+        auto plans = std::make_shared<NodeMap<UnrollPlan>>();
+
+        auto copies = [](const Node &loop, size_t count) {
+            Node block = Block;
+            for (size_t i = 0; i < count; i++) {
+                block << (loop / Do)->clone();
+            }
+            return block;
+        };
+
+        PassDef loop_unrolling = {
+            "loop_unrolling",
+            normalization_wf,
+            dir::bottomup | dir::once,
+            {
+                // while c do body
+                // becomes
+                // { body; ...; body }
+                // or, with a prologue running the remaining iterations
+                // { body; ...; while c do { body; ...; body } }
+                T(Stmt) << T(While)[While] >> [=](Match &_) -> Node {
+                    auto loop = _(While);
+                    auto res = plans->find(loop);
+                    if (res == plans->end()) {
+                        return NoChange;
+                    }
+
+                    auto plan = res->second;
+                    auto block = copies(loop, plan.prologue);
+
+                    if (!plan.full) {
+                        block
+                            << (Stmt
+                                << (While
+                                    << (loop / BExpr)
+                                    << (Stmt << copies(loop, plan.factor))));
+                    }
+                    if (block->empty()) {
+                        block << (Stmt << Skip);
+                    }
+                    return Stmt << block;
+                },
+            }};
+
+        loop_unrolling.pre([=](Node) {
+            plans->clear();
+
+            analysis->forward_worklist_algoritm(cfg, cp_first_state(cfg));
+            induction->compute();
+
+            // Only innermost loops are unrolled, the loops around them can
+            // be unrolled in later rounds
+            NodeSet outer_loops;
+            for (const auto &loop : cfg->get_loops()) {
+                if (auto parent = cfg->get_parent_loop(loop)) {
+                    outer_loops.insert(parent);
+                }
+            }
+
+            size_t growth = 0;
+            for (const auto &loop : cfg->get_loops()) {
+                if (outer_loops.contains(loop)) {
+                    continue;
+                }
+
+                auto trips =
+                    unroll_trip_count(cfg, analysis, *induction, loop);
+                if (!trips) {
+                    continue;
+                }
+
+                size_t size = unroll_size(loop / Do);
+                size_t count = *trips;
+                size_t full_growth = count > 1 ? (count - 1) * size : 0;
+
+                if (growth + full_growth <= budget) {
+                    growth += full_growth;
+                    plans->insert({loop, {count, 0, true}});
+                } else if (factor > 1 && count >= 2 * factor) {
+                    size_t prologue = count % factor;
+                    size_t added = (prologue + factor - 1) * size;
+
+                    if (growth + added <= budget) {
+                        growth += added;
+                        plans->insert({loop, {prologue, factor, false}});
+                    }
+                }
+            }
+
+            if (!plans->empty()) {
+                cfg->set_dirty_flag(true);
+            }
+            return 0;
+        });
+
+        loop_unrolling.post([=](Node) {
+            logging::Debug() << "Unrolled " << plans->size() << " loops";
+            return 0;
+        });
+
+        return loop_unrolling;
+    }
+}
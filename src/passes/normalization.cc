@@ -1,9 +1,82 @@
 #include "../internal.hh"
+#include "../utils.hh"
 
 namespace whilelang {
     using namespace trieste;
 
-    PassDef normalization() {
+    // A temporary is used exactly once, by the statement it was lifted out
+    // of, so its name is free again as soon as that use has been read
+    struct TempRecycler {
+        const std::set<std::string> &temps;
+        std::vector<std::string> free;
+        std::map<std::string, std::string> names;
+        size_t recycled = 0;
+
+        TempRecycler(const std::set<std::string> &temps) : temps(temps) {}
+
+        // Renames the temporaries used in n, returning the names whose
+        // lifetime ends with the use
+        void rename_uses(const Node &n, std::vector<std::string> &dead) {
+            for (auto &child : *n) {
+                if (child == Ident) {
+                    auto name = get_identifier(child);
+                    if (!temps.contains(name)) {
+                        continue;
+                    }
+
+                    auto res = names.find(name);
+                    if (res != names.end()) {
+                        name = res->second;
+                        n->replace(child, Ident ^ name);
+                    }
+                    dead.push_back(name);
+                } else if (child != FunId) {
+                    rename_uses(child, dead);
+                }
+            }
+        }
+
+        void recycle(const Node &n) {
+            std::vector<std::string> dead;
+
+            if (n == Assign) {
+                rename_uses(n / Rhs, dead);
+                free.insert(free.end(), dead.begin(), dead.end());
+
+                // The operands are read before the result is written, so
+                // the result may take the name of one of them
+                auto name = get_identifier(n / Ident);
+                if (temps.contains(name) && !free.empty()) {
+                    names[name] = free.back();
+                    n->replace(n / Ident, Ident ^ free.back());
+                    free.pop_back();
+                    recycled++;
+                }
+                return;
+            }
+
+            if (n == If || n == While) {
+                // Temporaries of the condition stay live in the branches
+                rename_uses(n / BExpr, dead);
+                for (auto &child : *n) {
+                    if (child == Stmt) {
+                        recycle(child);
+                    }
+                }
+            } else if (n == Output || n == Return) {
+                rename_uses(n, dead);
+            } else {
+                for (auto &child : *n) {
+                    recycle(child);
+                }
+            }
+            free.insert(free.end(), dead.begin(), dead.end());
+        }
+    };
+
+    PassDef normalization(bool recycle_temps) {
+        auto temps = std::make_shared<std::set<std::string>>();
+
         PassDef normalization = {
             "normalization",
             normalization_wf,
@@ -102,8 +175,9 @@ namespace whilelang {
                 },
 
                 T(Normalize) << (T(AExpr) << T(FunCall)[FunCall]) >>
-                    [](Match &_) -> Node {
+                    [=](Match &_) -> Node {
                     auto id = Ident ^ _(FunCall)->fresh();
+                    temps->insert(std::string(id->location().view()));
                     auto fun_id = _(FunCall) / FunId;
                     Node args = ArgList;
 
@@ -122,9 +196,10 @@ namespace whilelang {
                     -> Node { return Arg << (Normalize << _(AExpr)); },
 
                 T(Normalize) << (T(AExpr)[AExpr] << T(Add, Sub, Mul)[Op]) >>
-                    [](Match &_) -> Node {
+                    [=](Match &_) -> Node {
                     Node op = _(Op);
                     auto id = Ident ^ _(Op)->fresh();
+                    temps->insert(std::string(id->location().view()));
 
                     auto curr = op->front();
 
@@ -216,6 +291,18 @@ namespace whilelang {
                 program->push_back(*inst);
             }
 
+            if (recycle_temps) {
+                size_t recycled = 0;
+                for (auto &fun_def : *program) {
+                    TempRecycler recycler(*temps);
+                    recycler.recycle(fun_def / Body);
+                    recycled += recycler.recycled;
+                }
+                logging::Debug() << "Recycled " << recycled << " of "
+                                 << temps->size() << " temporaries";
+            }
+            temps->clear();
+
             return 0;
         });
 
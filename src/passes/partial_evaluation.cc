@@ -0,0 +1,351 @@
+#include "../analyses/input_dependence.hh"
+#include "../internal.hh"
+#include "../utils.hh"
+
+namespace whilelang {
+    using namespace trieste;
+
+    using PEEnv = std::map<std::string, int>;
+
+    // Executes statements at compile time. Execution gets stuck when it
+    // would read input or a variable with an unknown value, or when the
+    // step budget is used up.
+    class PartialEvaluator {
+      public:
+        enum class Status { Done, Returned, Stuck };
+
+        PartialEvaluator(
+            const InputDependence &input_dependence,
+            std::map<std::string, Node> functions,
+            size_t budget)
+            : input_dependence(input_dependence), functions(functions),
+              budget(budget) {}
+
+        // Runs a statement of main, the environment and the outputs are
+        // only updated if it could be executed completely
+        bool run(const Node &stmt, PEEnv &env, Nodes &outputs) {
+            if (input_dependence.reads_input(stmt)) {
+                return false;
+            }
+
+            auto new_env = env;
+            Nodes new_outputs;
+            if (exec(stmt, new_env, new_outputs) != Status::Done) {
+                return false;
+            }
+
+            env = new_env;
+            outputs.insert(
+                outputs.end(), new_outputs.begin(), new_outputs.end());
+            return true;
+        }
+
+        inline bool exhausted() const {
+            return budget == 0;
+        }
+
+      private:
+        const InputDependence &input_dependence;
+        std::map<std::string, Node> functions;
+        size_t budget;
+        std::optional<int> return_value;
+
+        bool step() {
+            if (budget == 0) {
+                return false;
+            }
+            budget--;
+            return true;
+        }
+
+        std::optional<int> atom(const Node &n, const PEEnv &env) {
+            auto expr = n / Expr;
+
+            if (expr == Int) {
+                return get_int_value(expr);
+            } else if (expr == Ident) {
+                auto res = env.find(get_identifier(expr));
+                if (res != env.end()) {
+                    return res->second;
+                }
+            }
+            return std::nullopt;
+        }
+
+        std::optional<int>
+        aexpr(const Node &n, const PEEnv &env, Nodes &outputs) {
+            auto expr = n / Expr;
+
+            if (expr == Atom) {
+                return atom(expr, env);
+            } else if (expr == FunCall) {
+                return call(expr, env, outputs);
+            }
+
+            auto lhs = atom(expr / Lhs, env);
+            auto rhs = atom(expr / Rhs, env);
+            if (!lhs || !rhs) {
+                return std::nullopt;
+            }
+            return calc_arithmetic_op(expr->type(), *lhs, *rhs);
+        }
+
+        std::optional<bool> bexpr(const Node &n, const PEEnv &env) {
+            auto expr = n / Expr;
+
+            if (expr->type().in({True, False})) {
+                return expr == True;
+            } else if (expr == Not) {
+                auto value = bexpr(expr / Expr, env);
+                return value ? std::optional<bool>(!*value) : std::nullopt;
+            } else if (expr->type().in({And, Or})) {
+                bool res = expr == And;
+
+                for (const auto &child : *expr) {
+                    auto value = bexpr(child, env);
+                    if (!value) {
+                        return std::nullopt;
+                    }
+                    res = expr == And ? res && *value : res || *value;
+                }
+                return res;
+            }
+
+            auto lhs = atom(expr / Lhs, env);
+            auto rhs = atom(expr / Rhs, env);
+            if (!lhs || !rhs) {
+                return std::nullopt;
+            }
+            return expr == Equals ? *lhs == *rhs : *lhs < *rhs;
+        }
+
+        // Functions run in their own frame, as in the analyses
+        std::optional<int>
+        call(const Node &fun_call, const PEEnv &env, Nodes &outputs) {
+            auto name = get_identifier((fun_call / FunId) / Ident);
+            auto res = functions.find(name);
+            if (res == functions.end()) {
+                return std::nullopt;
+            }
+
+            auto params = res->second / ParamList;
+            auto args = fun_call / ArgList;
+            if (params->size() != args->size()) {
+                return std::nullopt;
+            }
+
+            PEEnv frame;
+            for (size_t i = 0; i < params->size(); i++) {
+                auto value = atom(args->at(i) / Atom, env);
+                if (!value) {
+                    return std::nullopt;
+                }
+                frame[get_identifier(params->at(i) / Ident)] = *value;
+            }
+
+            if (exec(res->second / Body, frame, outputs) != Status::Returned) {
+                return std::nullopt;
+            }
+            return std::exchange(return_value, std::nullopt);
+        }
+
+        Status exec(const Node &stmt, PEEnv &env, Nodes &outputs) {
+            auto s = stmt / Stmt;
+
+            if (s == Block) {
+                for (const auto &child : *s) {
+                    auto status = exec(child, env, outputs);
+                    if (status != Status::Done) {
+                        return status;
+                    }
+                }
+                return Status::Done;
+            } else if (!step()) {
+                return Status::Stuck;
+            }
+
+            if (s == Skip) {
+                return Status::Done;
+            } else if (s == Assign) {
+                auto value = aexpr(s / Rhs, env, outputs);
+                if (!value) {
+                    return Status::Stuck;
+                }
+                env[get_identifier(s / Ident)] = *value;
+                return Status::Done;
+            } else if (s == Output) {
+                auto value = atom(s / Atom, env);
+                if (!value) {
+                    return Status::Stuck;
+                }
+                outputs.push_back(create_const_node(*value));
+                return Status::Done;
+            } else if (s == Return) {
+                return_value = atom(s / Atom, env);
+                return return_value ? Status::Returned : Status::Stuck;
+            } else if (s == If) {
+                auto cond = bexpr(s / BExpr, env);
+                if (!cond) {
+                    return Status::Stuck;
+                }
+                return exec(*cond ? s / Then : s / Else, env, outputs);
+            } else if (s == While) {
+                while (true) {
+                    auto cond = bexpr(s / BExpr, env);
+                    if (!cond) {
+                        return Status::Stuck;
+                    } else if (!*cond) {
+                        return Status::Done;
+                    }
+
+                    auto status = exec(s / Do, env, outputs);
+                    if (status != Status::Done) {
+                        return status;
+                    } else if (!step()) {
+                        return Status::Stuck;
+                    }
+                }
+            }
+            return Status::Stuck;
+        }
+    };
+
+    // A region which already only outputs and assigns constants
+    bool pe_is_residual(const Nodes &region) {
+        for (const auto &stmt : region) {
+            auto s = stmt / Stmt;
+
+            if (s == Output && (s / Atom) / Expr == Int) {
+                continue;
+            } else if (s == Assign && (s / Rhs) / Expr == Atom &&
+                       ((s / Rhs) / Expr) / Expr == Int) {
+                continue;
+            } else if (s != Skip) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    PassDef partial_evaluation(size_t budget) {
+        auto residuals = std::make_shared<NodeMap<Node>>();
+        auto removed = std::make_shared<NodeSet>();
+
+        PassDef partial_evaluation = {
+            "partial_evaluation",
+            normalization_wf,
+            dir::bottomup | dir::once,
+            {
+                In(Block) * T(Stmt)[Stmt] >> [=](Match &_) -> Node {
+                    auto res = residuals->find(_(Stmt));
+
+                    if (res != residuals->end()) {
+                        return res->second;
+                    } else if (removed->contains(_(Stmt))) {
+                        return {};
+                    }
+                    return NoChange;
+                },
+            }};
+
+        // Splits the body of main into regions of statements which can be
+        // executed without input. Each region is replaced by its outputs
+        // followed by the final values of the variables it assigns, so
+        // outputs keep their order relative to every input.
+        partial_evaluation.pre([=](Node n) {
+            residuals->clear();
+            removed->clear();
+
+            InputDependence input_dependence;
+            input_dependence.compute(n);
+
+            std::map<std::string, Node> functions;
+            Node main;
+            for (const auto &fun_def : *(n / Program)) {
+                auto name = get_identifier((fun_def / FunId) / Ident);
+                functions.insert({name, fun_def});
+
+                if (name == "main") {
+                    main = fun_def;
+                }
+            }
+
+            auto body = main ? (main / Body) / Stmt : Node{};
+            if (!body || body != Block) {
+                return 0;
+            }
+
+            PartialEvaluator evaluator(input_dependence, functions, budget);
+            PEEnv env;
+            Nodes region;
+            Nodes outputs;
+            Vars assigned;
+
+            auto end_region = [&]() {
+                if (!region.empty() && !pe_is_residual(region)) {
+                    Node block = Block;
+
+                    for (const auto &value : outputs) {
+                        block << (Stmt << (Output << (Atom << value)));
+                    }
+                    // A variable assigned on a branch that was not taken
+                    // keeps the value it had before the region, which may
+                    // be unknown
+                    for (const auto &var : assigned) {
+                        auto value = env.find(var);
+                        if (value == env.end()) {
+                            continue;
+                        }
+
+                        block
+                            << (Stmt
+                                << (Assign
+                                    << (Ident ^ var)
+                                    << (AExpr
+                                        << (Atom
+                                            << create_const_node(
+                                                   value->second)))));
+                    }
+                    if (block->empty()) {
+                        block << (Stmt << Skip);
+                    }
+
+                    residuals->insert({region.front(), Stmt << block});
+                    removed->insert(region.begin() + 1, region.end());
+                }
+
+                region.clear();
+                outputs.clear();
+                assigned.clear();
+            };
+
+            for (const auto &stmt : *body) {
+                if (!evaluator.exhausted() &&
+                    evaluator.run(stmt, env, outputs)) {
+                    auto vars = get_assigned_vars(stmt);
+                    assigned.insert(vars.begin(), vars.end());
+                    region.push_back(stmt);
+                    continue;
+                }
+
+                // Variables the statement may assign now depend on input
+                end_region();
+                for (const auto &var : get_assigned_vars(stmt)) {
+                    env.erase(var);
+                }
+            }
+            end_region();
+
+            return 0;
+        });
+
+        partial_evaluation.post([=](Node) {
+            logging::Debug() << "Partial evaluation replaced "
+                             << residuals->size() + removed->size()
+                             << " statements";
+            return 0;
+        });
+
+        return partial_evaluation;
+    }
+}
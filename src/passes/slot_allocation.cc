@@ -0,0 +1,47 @@
+#include "../analyses/slot_allocation.hh"
+#include "../internal.hh"
+#include "../utils.hh"
+
+namespace whilelang {
+    using namespace trieste;
+
+    PassDef slot_allocation(
+        std::shared_ptr<ControlFlow> cfg,
+        std::shared_ptr<SlotAllocation> slots) {
+        auto liveness = std::make_shared<LiveAnalysis>(cfg->get_arena());
+
+        PassDef slot_allocation = {
+            "slot_allocation",
+            normalization_wf,
+            dir::topdown | dir::once,
+            {
+                T(FunDef)[FunDef] >> [=](Match &_) -> Node {
+                    auto fun_def = _(FunDef);
+                    logging::Debug()
+                        << "Function "
+                        << get_identifier((fun_def / FunId) / Ident)
+                        << " uses " << slots->frame_size(fun_def)
+                        << " slots";
+                    return NoChange;
+                },
+            }};
+
+        slot_allocation.pre([=](Node) {
+            LiveState first_state = {};
+            liveness->backward_worklist_algoritm(cfg, first_state);
+            slots->compute(cfg, *liveness);
+            return 0;
+        });
+
+        slot_allocation.post([=](Node) {
+            for (const auto &[var, slot] : slots->get_slots()) {
+                logging::Trace() << var << " -> slot " << slot;
+            }
+            logging::Debug() << "Allocated slots for "
+                             << slots->get_slots().size() << " variables";
+            return 0;
+        });
+
+        return slot_allocation;
+    }
+}
@@ -0,0 +1,196 @@
+#include "../call_graph.hh"
+#include "../internal.hh"
+#include "../utils.hh"
+
+namespace whilelang {
+    using namespace trieste;
+
+    // The constant arguments of a call, in the order of the parameters
+    using SpecKey = std::pair<std::string, std::vector<std::optional<int>>>;
+
+    struct Specialization {
+        std::string name;
+        std::vector<std::optional<int>> constants;
+    };
+
+    void spec_gather_functions(
+        const Node &n, NodeSet &fun_defs, NodeSet &fun_calls, Nodes &calls) {
+        if (n == FunDef) {
+            fun_defs.insert(n);
+        } else if (n == FunCall) {
+            fun_calls.insert(n);
+            calls.push_back(n);
+        }
+
+        for (const auto &child : *n) {
+            spec_gather_functions(child, fun_defs, fun_calls, calls);
+        }
+    }
+
+    // Gives every variable of the clone a fresh name, so that the analyses
+    // never mix the variables of the clone and the original
+    void spec_rename(
+        const Node &n,
+        std::map<std::string, std::string> &names,
+        const Node &fresh_source) {
+        for (auto &child : *n) {
+            if (child == Ident) {
+                auto name = get_identifier(child);
+                auto res = names.find(name);
+
+                if (res == names.end()) {
+                    auto fresh = std::string(fresh_source->fresh().view());
+                    res = names.insert({name, fresh}).first;
+                }
+                n->replace(child, Ident ^ res->second);
+            } else if (child != FunId) {
+                spec_rename(child, names, fresh_source);
+            }
+        }
+    }
+
+    // The clone takes the parameters without a constant and starts by
+    // assigning the constants to the others
+    Node spec_clone(
+        const Node &fun_def,
+        const std::string &name,
+        const std::vector<std::optional<int>> &constants) {
+        auto clone = fun_def->clone();
+        std::map<std::string, std::string> names;
+        spec_rename(clone, names, fun_def);
+
+        auto params = clone / ParamList;
+        Node new_params = ParamList;
+        Node block = Block;
+
+        for (size_t i = 0; i < constants.size(); i++) {
+            auto param = params->at(i);
+
+            if (!constants[i]) {
+                new_params << param;
+                continue;
+            }
+
+            block
+                << (Stmt
+                    << (Assign
+                        << (param / Ident)->clone()
+                        << (AExpr
+                            << (Atom << create_const_node(*constants[i])))));
+        }
+        block << (clone / Body);
+
+        return FunDef << (FunId << (Ident ^ name)) << new_params
+                      << (Stmt << block);
+    }
+
+    PassDef specialize_functions(size_t limit) {
+        auto specialized = std::make_shared<NodeMap<Specialization>>();
+        auto clones = std::make_shared<Nodes>();
+
+        PassDef specialize_functions = {
+            "specialize_functions",
+            normalization_wf,
+            dir::bottomup | dir::once,
+            {
+                // f(a1, c, a2)
+                // becomes
+                // f'(a1, a2)
+                // where f' is a copy of f with the parameter of the
+                // constant c assigned at the start of its body
+                T(FunCall)[FunCall] >> [=](Match &_) -> Node {
+                    auto res = specialized->find(_(FunCall));
+                    if (res == specialized->end()) {
+                        return NoChange;
+                    }
+
+                    const auto &constants = res->second.constants;
+                    auto args = _(FunCall) / ArgList;
+                    Node new_args = ArgList;
+
+                    for (size_t i = 0; i < constants.size(); i++) {
+                        if (!constants[i]) {
+                            new_args << args->at(i)->clone();
+                        }
+                    }
+
+                    return FunCall << (FunId << (Ident ^ res->second.name))
+                                   << new_args;
+                },
+            }};
+
+        // Calls with the same constant arguments to the same function share
+        // one clone. Recursive functions are not specialized, as their own
+        // calls would keep producing new clones.
+        specialize_functions.pre([=](Node n) {
+            specialized->clear();
+            clones->clear();
+
+            NodeSet fun_defs;
+            NodeSet fun_calls;
+            Nodes calls;
+            spec_gather_functions(n, fun_defs, fun_calls, calls);
+
+            CallGraph call_graph;
+            call_graph.build(fun_defs, fun_calls);
+
+            std::map<SpecKey, std::string> names;
+            for (const auto &fun_call : calls) {
+                auto name = get_identifier((fun_call / FunId) / Ident);
+                auto callee = call_graph.get_fun_def(name);
+                auto args = fun_call / ArgList;
+
+                if (!callee || name == "main" ||
+                    call_graph.is_recursive(callee) ||
+                    (callee / ParamList)->size() != args->size()) {
+                    continue;
+                }
+
+                std::vector<std::optional<int>> constants;
+                bool has_constant = false;
+                for (const auto &arg : *args) {
+                    if ((arg / Atom) / Expr == Int) {
+                        constants.push_back(get_int_value((arg / Atom) / Expr));
+                        has_constant = true;
+                    } else {
+                        constants.push_back(std::nullopt);
+                    }
+                }
+                if (!has_constant) {
+                    continue;
+                }
+
+                SpecKey key = {name, constants};
+                auto res = names.find(key);
+
+                if (res == names.end()) {
+                    if (clones->size() >= limit) {
+                        continue;
+                    }
+
+                    auto clone_name =
+                        std::string(callee->fresh(Location(name)).view());
+                    clones->push_back(
+                        spec_clone(callee, clone_name, constants));
+                    res = names.insert({key, clone_name}).first;
+                }
+                specialized->insert({fun_call, {res->second, constants}});
+            }
+
+            return 0;
+        });
+
+        specialize_functions.post([=](Node n) {
+            auto program = n / Program;
+            for (const auto &clone : *clones) {
+                program << clone;
+            }
+
+            logging::Debug() << "Specialized " << specialized->size()
+                             << " calls with " << clones->size() << " clones";
+            return 0;
+        });
+
+        return specialize_functions;
+    }
+}
@@ -0,0 +1,275 @@
+#include "../internal.hh"
+#include "../utils.hh"
+
+namespace whilelang {
+    using namespace trieste;
+
+    // Maps every variable of a function to its current SSA name, variables
+    // missing from it are not yet defined on the current path
+    using SSAEnv = std::map<std::string, std::string>;
+
+    std::string ssa_lookup(const SSAEnv &env, const std::string &var) {
+        auto res = env.find(var);
+        return res != env.end() ? res->second : var;
+    }
+
+    std::string ssa_fresh(Node fun_def) {
+        return std::string(fun_def->fresh().view());
+    }
+
+    // A statement returns if every path through it ends in a return
+    bool ssa_returns(const Node &stmt) {
+        auto s = stmt / Stmt;
+
+        if (s == Return) {
+            return true;
+        } else if (s == Block) {
+            return ssa_returns(s->back());
+        } else if (s == If) {
+            return ssa_returns(s / Then) && ssa_returns(s / Else);
+        }
+        return false;
+    }
+
+    Node ssa_atom(const Node &atom, const SSAEnv &env) {
+        auto expr = atom / Expr;
+
+        if (expr == Ident) {
+            return Atom << (Ident ^ ssa_lookup(env, get_identifier(expr)));
+        }
+        return Atom << expr->clone();
+    }
+
+    Node ssa_aexpr(const Node &aexpr, const SSAEnv &env) {
+        auto expr = aexpr / Expr;
+
+        if (expr == Atom) {
+            return AExpr << ssa_atom(expr, env);
+        } else if (expr->type().in({Add, Sub, Mul})) {
+            return AExpr
+                << (expr->type() << ssa_atom(expr / Lhs, env)
+                                 << ssa_atom(expr / Rhs, env));
+        }
+
+        Node args = ArgList;
+        for (auto arg : *(expr / ArgList)) {
+            args << (Arg << ssa_atom(arg / Atom, env));
+        }
+        return AExpr << (FunCall << (expr / FunId)->clone() << args);
+    }
+
+    Node ssa_bexpr(const Node &bexpr, const SSAEnv &env) {
+        auto expr = bexpr / Expr;
+
+        if (expr->type().in({LT, Equals})) {
+            return BExpr
+                << (expr->type() << ssa_atom(expr / Lhs, env)
+                                 << ssa_atom(expr / Rhs, env));
+        } else if (expr->type().in({And, Or})) {
+            Node res = expr->type();
+            for (auto child : *expr) {
+                res << ssa_bexpr(child, env);
+            }
+            return BExpr << res;
+        } else if (expr == Not) {
+            return BExpr << (Not << ssa_bexpr(expr / Expr, env));
+        }
+        return BExpr << expr->clone();
+    }
+
+    Node ssa_stmt(const Node &stmt, SSAEnv &env, Node fun_def) {
+        auto s = stmt / Stmt;
+
+        if (s == Block) {
+            Node block = Block;
+            for (auto child : *s) {
+                block << ssa_stmt(child, env, fun_def);
+            }
+            return Stmt << block;
+        } else if (s == Assign) {
+            auto rhs = ssa_aexpr(s / Rhs, env);
+            auto name = ssa_fresh(fun_def);
+
+            env[get_identifier(s / Ident)] = name;
+            return Stmt << (Assign << (Ident ^ name) << rhs);
+        } else if (s == Output) {
+            return Stmt << (Output << ssa_atom(s / Atom, env));
+        } else if (s == Return) {
+            return Stmt << (Return << ssa_atom(s / Atom, env));
+        } else if (s == If) {
+            auto cond = ssa_bexpr(s / BExpr, env);
+
+            auto then_env = env;
+            auto then_stmt = ssa_stmt(s / Then, then_env, fun_def);
+            auto else_env = env;
+            auto else_stmt = ssa_stmt(s / Else, else_env, fun_def);
+
+            // A branch that returns never reaches the join
+            bool then_returns = ssa_returns(s / Then);
+            bool else_returns = ssa_returns(s / Else);
+            Node phis = Phis;
+
+            if (then_returns || else_returns) {
+                env = then_returns ? else_env : then_env;
+                return Stmt << (If << cond << then_stmt << else_stmt << phis);
+            }
+
+            Vars vars;
+            for (const auto &[var, _] : then_env) {
+                vars.insert(var);
+            }
+            for (const auto &[var, _] : else_env) {
+                vars.insert(var);
+            }
+
+            // A variable defined on only one of the paths keeps the name
+            // from that path, reading it after the other path is an error
+            // in the original program as well
+            for (const auto &var : vars) {
+                if (!then_env.contains(var) || !else_env.contains(var)) {
+                    env[var] = ssa_lookup(
+                        then_env.contains(var) ? then_env : else_env, var);
+                    continue;
+                }
+
+                auto then_name = then_env[var];
+                auto else_name = else_env[var];
+
+                if (then_name != else_name) {
+                    auto name = ssa_fresh(fun_def);
+                    phis
+                        << (Phi << (Ident ^ name)
+                                << (Atom << (Ident ^ then_name))
+                                << (Atom << (Ident ^ else_name)));
+                    env[var] = name;
+                }
+            }
+            return Stmt << (If << cond << then_stmt << else_stmt << phis);
+        } else if (s == While) {
+            // Children are accessed by position as the While shape differs
+            // between normalization_wf and ssa_wf
+            auto bexpr = s->front();
+            auto do_stmt = s->back();
+
+            // Every variable assigned in the loop needs a phi at the header
+            auto assigned = get_assigned_vars(do_stmt);
+
+            auto entry_env = env;
+            for (const auto &var : assigned) {
+                env[var] = ssa_fresh(fun_def);
+            }
+
+            auto cond = ssa_bexpr(bexpr, env);
+            auto body_env = env;
+            auto body = ssa_stmt(do_stmt, body_env, fun_def);
+
+            // A variable not defined when entering the loop gets the name
+            // of the phi itself as its entry value, so no copy is made
+            Node phis = Phis;
+            for (const auto &var : assigned) {
+                auto name = env[var];
+                auto entry_name =
+                    entry_env.contains(var) ? entry_env[var] : name;
+
+                phis
+                    << (Phi << (Ident ^ name)
+                            << (Atom << (Ident ^ entry_name))
+                            << (Atom << (Ident ^ ssa_lookup(body_env, var))));
+            }
+
+            // The loop is always left from the header
+            return Stmt << (While << phis << cond << body);
+        }
+        return Stmt << s->clone();
+    }
+
+    // Appends the copy of a phi operand to the block, unless the operand is
+    // the phi itself
+    void ssa_phi_copy(Node &block, const Node &phi, size_t side) {
+        auto name = phi->front();
+        auto value = phi->at(side);
+        if (get_identifier(value->front()) == get_identifier(name)) {
+            return;
+        }
+
+        block
+            << (Stmt << (Assign << name->clone() << (AExpr << value->clone())));
+    }
+
+    // Appends a copy for each phi to the end of the given block statement,
+    // side is the position of the phi operand to copy from
+    Node ssa_phi_copies(const Node &stmt, const Node &phis, size_t side) {
+        if (ssa_returns(stmt)) {
+            return stmt;
+        }
+
+        Node block = Block;
+        block << *(stmt / Stmt);
+        for (auto phi : *phis) {
+            ssa_phi_copy(block, phi, side);
+        }
+        return Stmt << block;
+    }
+
+    PassDef to_ssa() {
+        return {
+            "to_ssa",
+            ssa_wf,
+            dir::topdown | dir::once,
+            {
+                T(FunDef)[FunDef] >> [](Match &_) -> Node {
+                    auto fun_def = _(FunDef);
+                    SSAEnv env;
+
+                    // Parameters are defined on entry and keep their names
+                    // until they are assigned
+                    for (const auto &param : *(fun_def / ParamList)) {
+                        auto name = get_identifier(param / Ident);
+                        env[name] = name;
+                    }
+
+                    auto body = ssa_stmt(fun_def / Body, env, fun_def);
+
+                    return FunDef << (fun_def / FunId) << (fun_def / ParamList)
+                                  << body;
+                },
+            }};
+    }
+
+    // Phi nodes are replaced with copies at the end of the predecessors.
+    // The copies of one join can be sequentialized since a phi never uses
+    // the result of another phi of the same join, each SSA name belongs to
+    // exactly one original variable.
+    PassDef from_ssa() {
+        return {
+            "from_ssa",
+            normalization_wf,
+            dir::bottomup | dir::once,
+            {
+                T(Stmt)
+                        << (T(If)
+                            << (T(BExpr)[BExpr] * T(Stmt)[Then] *
+                                T(Stmt)[Else] * T(Phis)[Phis])) >>
+                    [](Match &_) -> Node {
+                    auto then_stmt = ssa_phi_copies(_(Then), _(Phis), 1);
+                    auto else_stmt = ssa_phi_copies(_(Else), _(Phis), 2);
+
+                    return Stmt << (If << _(BExpr) << then_stmt << else_stmt);
+                },
+
+                T(Stmt)
+                        << (T(While)
+                            << (T(Phis)[Phis] * T(BExpr)[BExpr] *
+                                T(Stmt)[Do])) >>
+                    [](Match &_) -> Node {
+                    Node res = Seq;
+                    for (auto phi : *_(Phis)) {
+                        ssa_phi_copy(res, phi, 1);
+                    }
+
+                    auto body = ssa_phi_copies(_(Do), _(Phis), 2);
+                    return res << (Stmt << (While << _(BExpr) << body));
+                },
+            }};
+    }
+}
@@ -0,0 +1,123 @@
+#include "../analyses/induction_variables.hh"
+#include "../internal.hh"
+#include "../utils.hh"
+
+namespace whilelang {
+    using namespace trieste;
+
+    // Loop, basic induction variable and factor of a reduced multiplication
+    using ReductionKey = std::tuple<Node, std::string, int>;
+
+    Node sr_assign(const std::string &var, Node expr) {
+        return Stmt << (Assign << (Ident ^ var) << (AExpr << expr));
+    }
+
+    Node sr_atom(const std::string &var) {
+        return Atom << (Ident ^ var);
+    }
+
+    PassDef strength_reduction(std::shared_ptr<ControlFlow> cfg) {
+        auto induction = std::make_shared<InductionVariables>(cfg);
+        auto reduced = std::make_shared<NodeMap<std::string>>();
+        auto updates = std::make_shared<NodeMap<Nodes>>();
+        auto inits = std::make_shared<NodeMap<Nodes>>();
+
+        PassDef strength_reduction = {
+            "strength_reduction",
+            normalization_wf,
+            dir::bottomup | dir::once,
+            {
+                // j := i * k
+                // becomes
+                // j := t
+                // where t holds i * k in the whole loop
+                T(Stmt) << T(Assign)[Assign] >> [=](Match &_) -> Node {
+                    auto assign = _(Assign);
+                    auto temp = reduced->find(assign);
+                    auto update = updates->find(assign);
+
+                    if (temp != reduced->end()) {
+                        return sr_assign(
+                            get_identifier(assign / Ident),
+                            sr_atom(temp->second));
+                    }
+
+                    // i := i + c
+                    // becomes
+                    // { i := i + c; t := t + c * k }
+                    if (update != updates->end()) {
+                        Node block = Block << (Stmt << assign);
+                        for (const auto &stmt : update->second) {
+                            block << stmt->clone();
+                        }
+                        return Stmt << block;
+                    }
+                    return NoChange;
+                },
+
+                // while c do body
+                // becomes
+                // { t := i * k; while c do body }
+                T(Stmt) << T(While)[While] >> [=](Match &_) -> Node {
+                    auto res = inits->find(_(While));
+                    if (res == inits->end()) {
+                        return NoChange;
+                    }
+
+                    Node block = Block;
+                    for (const auto &init : res->second) {
+                        block << init->clone();
+                    }
+                    return Stmt << (block << (Stmt << _(While)));
+                },
+            }};
+
+        strength_reduction.pre([=](Node n) {
+            reduced->clear();
+            updates->clear();
+            inits->clear();
+
+            induction->compute();
+
+            // Multiplications of the same variable by the same factor in a
+            // loop share one recurrence
+            std::map<ReductionKey, std::string> recurrences;
+
+            for (const auto &[assign, derived] : induction->get_derived()) {
+                ReductionKey key = {
+                    derived.loop, derived.base, derived.factor};
+                auto res = recurrences.find(key);
+
+                if (res == recurrences.end()) {
+                    auto temp = std::string(n->fresh().view());
+                    res = recurrences.insert({key, temp}).first;
+
+                    const auto &basic =
+                        induction->get_basic(derived.loop).at(derived.base);
+                    auto step = create_const_node(basic.step * derived.factor);
+
+                    (*inits)[derived.loop].push_back(sr_assign(
+                        temp,
+                        Mul << sr_atom(derived.base)
+                            << (Atom << create_const_node(derived.factor))));
+                    (*updates)[basic.update].push_back(sr_assign(
+                        temp, Add << sr_atom(temp) << (Atom << step)));
+                }
+                reduced->insert({assign, res->second});
+            }
+
+            if (!reduced->empty()) {
+                cfg->set_dirty_flag(true);
+            }
+            return 0;
+        });
+
+        strength_reduction.post([=](Node) {
+            logging::Debug() << "Strength reduction replaced "
+                             << reduced->size() << " multiplications";
+            return 0;
+        });
+
+        return strength_reduction;
+    }
+}
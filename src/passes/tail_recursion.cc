@@ -0,0 +1,307 @@
+#include "../internal.hh"
+#include "../utils.hh"
+
+namespace whilelang {
+    using namespace trieste;
+
+    struct TRContext {
+        std::string name;
+        size_t arity;
+        // Operation of the accumulator, if any recursive call is followed
+        // by y := a op x
+        std::optional<Token> op;
+        size_t tail_calls = 0;
+
+        std::string cont;
+        std::string res;
+        std::string acc;
+    };
+
+    bool tr_self_call(const Node &stmt, const std::string &name) {
+        auto s = stmt / Stmt;
+        if (s != Assign) {
+            return false;
+        }
+
+        auto expr = (s / Rhs) / Expr;
+        return expr == FunCall &&
+            get_identifier((expr / FunId) / Ident) == name;
+    }
+
+    bool tr_contains_self_call(const Node &n, const std::string &name) {
+        if (n == FunCall && get_identifier((n / FunId) / Ident) == name) {
+            return true;
+        }
+
+        for (const auto &child : *n) {
+            if (tr_contains_self_call(child, name)) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    bool tr_returns_var(const Node &stmt, const std::string &var) {
+        auto s = stmt / Stmt;
+        return s == Return && (s / Atom) / Expr == Ident &&
+            get_identifier((s / Atom) / Expr) == var;
+    }
+
+    // The operand combined with the result of the call, for a statement
+    // y := a op x where x is the result
+    Node tr_accumulated(const Node &stmt, const std::string &result) {
+        auto s = stmt / Stmt;
+        if (s != Assign) {
+            return {};
+        }
+
+        auto expr = (s / Rhs) / Expr;
+        if (!expr->type().in({Add, Mul})) {
+            return {};
+        }
+
+        auto is_result = [&](const Node &atom) {
+            return atom / Expr == Ident &&
+                get_identifier(atom / Expr) == result;
+        };
+
+        auto lhs = expr / Lhs;
+        auto rhs = expr / Rhs;
+        if (is_result(lhs) && !is_result(rhs)) {
+            return rhs;
+        } else if (is_result(rhs) && !is_result(lhs)) {
+            return lhs;
+        }
+        return {};
+    }
+
+    // Number of statements of the recursive call pattern starting at i of
+    // the block, either x := f(args); return x or
+    // x := f(args); y := a op x; return y. Zero if there is none.
+    size_t tr_pattern(const Node &block, size_t i, const std::string &name) {
+        if (!tr_self_call(block->at(i), name)) {
+            return 0;
+        }
+
+        auto result = get_identifier((block->at(i) / Stmt) / Ident);
+        size_t rest = block->size() - i;
+
+        if (rest == 2 && tr_returns_var(block->at(i + 1), result)) {
+            return 2;
+        } else if (
+            rest == 3 && tr_accumulated(block->at(i + 1), result) &&
+            tr_returns_var(
+                block->at(i + 2),
+                get_identifier((block->at(i + 1) / Stmt) / Ident))) {
+            return 3;
+        }
+        return 0;
+    }
+
+    // Every path through the statement ends in a return
+    bool tr_returns(const Node &stmt) {
+        auto s = stmt / Stmt;
+
+        if (s == Return) {
+            return true;
+        } else if (s == Block) {
+            return !s->empty() && tr_returns(s->back());
+        } else if (s == If) {
+            return tr_returns(s / Then) && tr_returns(s / Else);
+        }
+        return false;
+    }
+
+    // Checks that every return and recursive call is in tail position
+    bool tr_analyze(const Node &stmt, TRContext &ctx, bool tail) {
+        auto s = stmt / Stmt;
+
+        if (s == Block) {
+            for (size_t i = 0; i < s->size(); i++) {
+                auto length = tr_pattern(s, i, ctx.name);
+
+                if (length == 0) {
+                    bool last = i == s->size() - 1;
+                    if (!tr_analyze(s->at(i), ctx, tail && last)) {
+                        return false;
+                    }
+                    continue;
+                }
+
+                // The parameters can only be rebound if the arity matches
+                auto args = (((s->at(i) / Stmt) / Rhs) / Expr) / ArgList;
+                if (!tail || args->size() != ctx.arity) {
+                    return false;
+                }
+
+                if (length == 3) {
+                    auto op = ((s->at(i + 1) / Stmt) / Rhs) / Expr;
+                    if (ctx.op && *ctx.op != op->type()) {
+                        return false;
+                    }
+                    ctx.op = op->type();
+                }
+
+                ctx.tail_calls++;
+                i += length - 1;
+            }
+            return true;
+        } else if (s == Return) {
+            return tail;
+        } else if (s == If) {
+            return tr_analyze(s / Then, ctx, tail) &&
+                tr_analyze(s / Else, ctx, tail);
+        } else if (s == While) {
+            return tr_analyze(s / Do, ctx, false);
+        }
+        return !tr_contains_self_call(s, ctx.name);
+    }
+
+    Node tr_assign(const std::string &var, Node expr) {
+        return Stmt << (Assign << (Ident ^ var) << (AExpr << expr));
+    }
+
+    Node tr_atom(const std::string &var) {
+        return Atom << (Ident ^ var);
+    }
+
+    // Returns store the result and leave the loop, recursive calls
+    // rebind the parameters and run the loop again
+    Node tr_transform(
+        const Node &stmt,
+        const Node &fun_def,
+        const TRContext &ctx,
+        bool accumulate) {
+        auto s = stmt / Stmt;
+
+        if (s == Block) {
+            Node block = Block;
+
+            for (size_t i = 0; i < s->size(); i++) {
+                auto length = tr_pattern(s, i, ctx.name);
+
+                if (length == 0) {
+                    block << tr_transform(s->at(i), fun_def, ctx, accumulate);
+                    continue;
+                }
+
+                auto params = fun_def / ParamList;
+                auto args = (((s->at(i) / Stmt) / Rhs) / Expr) / ArgList;
+                std::vector<std::string> temps;
+
+                // The arguments are evaluated before any parameter changes
+                for (const auto &arg : *args) {
+                    temps.push_back(std::string(fun_def->fresh().view()));
+                    block << tr_assign(temps.back(), (arg / Atom)->clone());
+                }
+
+                if (length == 3) {
+                    auto result = get_identifier((s->at(i) / Stmt) / Ident);
+                    auto operand = tr_accumulated(s->at(i + 1), result);
+
+                    block << tr_assign(
+                        ctx.acc,
+                        ctx.op.value() << tr_atom(ctx.acc)
+                                       << operand->clone());
+                }
+
+                for (size_t j = 0; j < params->size(); j++) {
+                    block << tr_assign(
+                        get_identifier(params->at(j) / Ident),
+                        tr_atom(temps[j]));
+                }
+                block << tr_assign(ctx.cont, Atom << create_const_node(1));
+
+                i += length - 1;
+            }
+            return Stmt << block;
+        } else if (s == Return) {
+            if (accumulate) {
+                return tr_assign(
+                    ctx.res,
+                    ctx.op.value() << tr_atom(ctx.acc)
+                                   << (s / Atom)->clone());
+            }
+            return tr_assign(ctx.res, (s / Atom)->clone());
+        } else if (s == If) {
+            return Stmt
+                << (If << (s / BExpr)->clone()
+                       << tr_transform(s / Then, fun_def, ctx, accumulate)
+                       << tr_transform(s / Else, fun_def, ctx, accumulate));
+        }
+        return Stmt << s->clone();
+    }
+
+    PassDef tail_recursion() {
+        auto transformed = std::make_shared<size_t>(0);
+
+        PassDef tail_recursion = {
+            "tail_recursion",
+            normalization_wf,
+            dir::bottomup | dir::once,
+            {
+                // fun f(p) { body }
+                // becomes
+                // fun f(p) {
+                //     acc := identity of op;
+                //     cont := 1;
+                //     while cont = 1 do { cont := 0; body' };
+                //     return res
+                // }
+                T(FunDef)[FunDef] >> [=](Match &_) -> Node {
+                    auto fun_def = _(FunDef);
+                    auto body = fun_def / Body;
+
+                    TRContext ctx;
+                    ctx.name = get_identifier((fun_def / FunId) / Ident);
+                    ctx.arity = (fun_def / ParamList)->size();
+
+                    if (ctx.name == "main" || !tr_returns(body) ||
+                        !tr_analyze(body, ctx, true) || ctx.tail_calls == 0) {
+                        return NoChange;
+                    }
+
+                    ctx.cont = std::string(fun_def->fresh().view());
+                    ctx.res = std::string(fun_def->fresh().view());
+                    ctx.acc = std::string(fun_def->fresh().view());
+
+                    bool accumulate = ctx.op.has_value();
+                    Node block = Block;
+
+                    if (accumulate) {
+                        auto identity = *ctx.op == Add ? 0 : 1;
+                        block << tr_assign(
+                            ctx.acc, Atom << create_const_node(identity));
+                    }
+                    block << tr_assign(ctx.cont, Atom << create_const_node(1));
+
+                    auto cond = BExpr
+                        << (Equals << tr_atom(ctx.cont)
+                                   << (Atom << create_const_node(1)));
+                    auto loop_body = Block
+                        << tr_assign(ctx.cont, Atom << create_const_node(0))
+                        << tr_transform(body, fun_def, ctx, accumulate);
+
+                    block << (Stmt << (While << cond << (Stmt << loop_body)));
+                    block << (Stmt << (Return << tr_atom(ctx.res)));
+
+                    (*transformed)++;
+                    return FunDef << (fun_def / FunId) << (fun_def / ParamList)
+                                  << (Stmt << block);
+                },
+            }};
+
+        tail_recursion.pre([=](Node) {
+            *transformed = 0;
+            return 0;
+        });
+
+        tail_recursion.post([=](Node) {
+            logging::Debug() << "Tail recursion turned " << *transformed
+                             << " functions into loops";
+            return 0;
+        });
+
+        return tail_recursion;
+    }
+}
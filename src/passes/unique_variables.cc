@@ -5,8 +5,11 @@ namespace whilelang {
 
     using namespace trieste;
 
+    // Scoped names start with the name of the function, so functions which
+    // are resolved on their own still get distinct names
     PassDef unique_variables(
-        std::shared_ptr<std::map<std::string, std::string>> vars_map) {
+        std::shared_ptr<std::map<std::string, std::string>> vars_map,
+        bool scoped) {
         return {
             "unique_variables",
             statements_wf,
@@ -18,7 +21,11 @@ namespace whilelang {
                     auto new_var = vars_map->find(var);
 
                     if (new_var == vars_map->end()) {
-                        auto new_name = std::string(_(Ident)->fresh().view());
+                        auto prefix =
+                            scoped ? Location(var.substr(0, var.find('-')))
+                                   : Location();
+                        auto new_name =
+                            std::string(_(Ident)->fresh(prefix).view());
                         vars_map->insert({var, new_name});
 
                         return Ident ^ new_name;
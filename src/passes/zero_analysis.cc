@@ -6,27 +6,117 @@
 namespace whilelang {
     using namespace trieste;
 
-    PassDef z_analysis(std::shared_ptr<ControlFlow> cfg) {
+    PassDef z_analysis(std::shared_ptr<ControlFlow> cfg, bool log_states) {
+        auto analysis = std::make_shared<
+            DataFlowAnalysis<ZeroState, ZeroLatticeValue, ZeroImpl>>(
+            cfg->get_arena());
+        auto simplified = std::make_shared<size_t>(0);
+
+        // The state when the instruction is reached, the states of the table
+        // are the ones leaving each instruction
+        auto incoming_state = [=](const Node &inst) {
+            auto state = ZeroImpl::create_state(
+                cfg->get_vars(), cfg->get_arena()->resource());
+
+            for (const auto &pred : cfg->predecessors(inst)) {
+                ZeroImpl::state_join(state, analysis->get_state(pred));
+            }
+            return state;
+        };
+
+        // Reading input can not be removed
+        auto reads_input = [](const Node &op) {
+            return (op / Lhs) / Expr == Input || (op / Rhs) / Expr == Input;
+        };
+
         PassDef z_analysis = {
-            "z_analysis", normalization_wf, dir::topdown | dir::once, {}};
+            "z_analysis",
+            normalization_wf,
+            dir::bottomup | dir::once,
+            {
+                // x * 0 becomes 0, x + 0, 0 + x and x - 0 become x
+                In(AExpr) * T(Add, Sub, Mul)[Op] >> [=](Match &_) -> Node {
+                    auto op = _(Op);
+                    if (reads_input(op)) {
+                        return NoChange;
+                    }
 
-        z_analysis.post([=](Node) {
-            auto analysis = std::make_shared<
-                DataFlowAnalysis<ZeroState, ZeroLatticeValue, ZeroImpl>>();
-            auto first_state = ZeroState();
+                    auto state = incoming_state(op->parent()->parent());
+                    auto lhs = handle_atom((op / Lhs) / Expr, state);
+                    auto rhs = handle_atom((op / Rhs) / Expr, state);
+                    auto zero = ZeroLatticeValue::zero();
+                    Node res;
+
+                    if (op == Mul && (lhs == zero || rhs == zero)) {
+                        res = Atom << create_const_node(0);
+                    } else if (op == Add && lhs == zero) {
+                        res = op / Rhs;
+                    } else if (rhs == zero) {
+                        res = op / Lhs;
+                    } else {
+                        return NoChange;
+                    }
+
+                    (*simplified)++;
+                    cfg->set_dirty_flag(true);
+                    return res;
+                },
+
+                // Comparisons decided by the signs of the operands
+                In(BExpr) * T(LT, Equals)[Op] >> [=](Match &_) -> Node {
+                    auto op = _(Op);
+                    if (reads_input(op)) {
+                        return NoChange;
+                    }
+
+                    // Only the outermost condition is an instruction
+                    auto inst = op->parent();
+                    while (inst->parent()->type().in({BExpr, And, Or, Not})) {
+                        inst = inst->parent();
+                    }
 
+                    auto state = incoming_state(inst);
+                    auto res = zero_compare(
+                        op,
+                        handle_atom((op / Lhs) / Expr, state),
+                        handle_atom((op / Rhs) / Expr, state));
+
+                    if (!res) {
+                        return NoChange;
+                    }
+
+                    (*simplified)++;
+                    cfg->set_dirty_flag(true);
+                    return *res ? True : False;
+                },
+            }};
+
+        z_analysis.pre([=](Node) {
+            *simplified = 0;
+
+            auto first_state = ZeroState(cfg->get_arena()->resource());
             for (auto var : cfg->get_vars()) {
                 first_state[var] = ZeroLatticeValue::top();
             }
 
             analysis->forward_worklist_algoritm(cfg, first_state);
 
-            cfg->log_instructions();
-            analysis->log_state_table(cfg);
+            // Printing the state table is expensive, so it is only built
+            // when it is logged
+            if (log_states) {
+                cfg->log_instructions();
+                analysis->log_state_table(cfg);
+            }
 
             return 0;
         });
 
+        z_analysis.post([=](Node) {
+            logging::Debug() << "Zero analysis simplified " << *simplified
+                             << " expressions";
+            return 0;
+        });
+
         return z_analysis;
     }
 }
@@ -3,37 +3,101 @@
 namespace whilelang {
     using namespace trieste;
 
-    Reader reader(
+    std::vector<Pass> parsing_passes(bool run_mermaid) {
+        auto mermaid_cond = [=](Node) { return run_mermaid; };
+        return {
+            generate_mermaid(parse_wf).cond(mermaid_cond),
+            functions(),
+            generate_mermaid(functions_wf).cond(mermaid_cond),
+            expressions(),
+            generate_mermaid(expressions_wf).cond(mermaid_cond),
+            statements(),
+            generate_mermaid(statements_wf).cond(mermaid_cond),
+        };
+    }
+
+    std::vector<Pass> resolution_passes(
         std::shared_ptr<std::map<std::string, std::string>> vars_map,
         bool run_stats,
-        bool run_mermaid) {
+        bool run_mermaid,
+        bool run_ssa,
+        bool recycle_temps) {
         auto mermaid_cond = [=](Node) { return run_mermaid; };
+        auto ssa_cond = [=](Node) { return run_ssa; };
+        return {
+            // Checking
+            check_refs(),
+
+            // Fix unique variables
+            unique_variables(vars_map),
+
+            // Normalization
+            normalization(recycle_temps),
+            // generate_mermaid().cond(mermaid_cond),
+
+            // Round trip through SSA form, splitting the live ranges of
+            // reassigned variables
+            to_ssa().cond(ssa_cond),
+            generate_mermaid(ssa_wf).cond(
+                [=](Node n) { return run_ssa && mermaid_cond(n); }),
+            from_ssa().cond(ssa_cond),
+
+            // Used for perfomance analysis
+            gather_stats().cond([=](Node) { return run_stats; }),
+        };
+    }
+
+    Reader reader(
+        std::shared_ptr<std::map<std::string, std::string>> vars_map,
+        bool run_stats,
+        bool run_mermaid,
+        bool run_ssa,
+        bool recycle_temps,
+        std::function<void()> parsed) {
+        auto passes = parsing_passes(run_mermaid);
+        auto resolution = resolution_passes(
+            vars_map, run_stats, run_mermaid, run_ssa, recycle_temps);
+        passes.insert(passes.end(), resolution.begin(), resolution.end());
+
         return {
             "while",
-            {
-                // Parsing
-                generate_mermaid(parse_wf).cond(mermaid_cond),
-                functions(),
-                generate_mermaid(functions_wf).cond(mermaid_cond),
-                expressions(),
-                generate_mermaid(expressions_wf).cond(mermaid_cond),
-                statements(),
-                generate_mermaid(statements_wf).cond(mermaid_cond),
-
-                // Checking
-                check_refs(),
+            passes,
+            whilelang::parser(parsed),
+        };
+    }
 
-                // Fix unique variables
-                unique_variables(vars_map),
+    Reader function_reader() {
+        return {
+            "while_functions",
+            parsing_passes(false),
+            whilelang::parser(),
+        };
+    }
 
-                // Normalization
-                normalization(),
-                // generate_mermaid().cond(mermaid_cond),
+    Rewriter resolution(
+        std::shared_ptr<std::map<std::string, std::string>> vars_map,
+        bool run_stats,
+        bool run_mermaid,
+        bool run_ssa,
+        bool recycle_temps) {
+        return {
+            "while_resolution",
+            resolution_passes(
+                vars_map, run_stats, run_mermaid, run_ssa, recycle_temps),
+            statements_wf,
+        };
+    }
 
-                // Used for perfomance analysis
-                gather_stats().cond([=](Node) { return run_stats; }),
+    Rewriter function_resolution(
+        std::shared_ptr<std::map<std::string, std::string>> vars_map) {
+        return {
+            "while_function_resolution",
+            {
+                check_refs(),
+                unique_variables(vars_map, true),
+                normalization(false),
             },
-            whilelang::parser(),
+            statements_wf,
         };
     }
 }
@@ -0,0 +1,232 @@
+#include "serialization.hh"
+
+#include "internal.hh"
+#include "source.hh"
+#include "utils.hh"
+
+#include <charconv>
+#include <fstream>
+
+namespace whilelang {
+    using namespace trieste;
+
+    const std::string serial_magic = "WAST";
+    const uint8_t serial_version = 1;
+
+    // The id of a token is its index, new tokens must be added at the end
+    // and the version increased when the layout changes
+    const std::vector<Token> serial_tokens = {
+        Top, Program,
+        FunDef, FunId, ParamList, Param, Ident,
+        Stmt, Block, Skip, Assign, While, If, Output, Return,
+        AExpr, BExpr, Atom, Int, Input,
+        Add, Sub, Mul,
+        FunCall, ArgList, Arg,
+        True, False, Not, LT, Equals, And, Or,
+    };
+
+    // Integers are written in seven bit groups, least significant first,
+    // with the high bit set on every group but the last
+    void serial_write(std::string &out, size_t value) {
+        while (value >= 0x80) {
+            out += static_cast<char>((value & 0x7F) | 0x80);
+            value >>= 7;
+        }
+        out += static_cast<char>(value);
+    }
+
+    struct SerialWriter {
+        std::map<Token, size_t> token_ids;
+        std::map<std::string, size_t> string_ids;
+        std::vector<std::string> strings;
+        std::string nodes;
+
+        SerialWriter() {
+            for (size_t i = 0; i < serial_tokens.size(); i++) {
+                token_ids[serial_tokens[i]] = i;
+            }
+        }
+
+        void write(const Node &n) {
+            auto id = token_ids.find(n->type());
+            if (id == token_ids.end()) {
+                throw std::runtime_error(
+                    "Can not serialize " + std::string(n->type().str()) +
+                    ", the program is not normalized");
+            }
+            serial_write(nodes, id->second);
+
+            if (n == Ident || n == Int) {
+                auto text = std::string(n->location().view());
+                auto [res, inserted] =
+                    string_ids.try_emplace(text, strings.size());
+                if (inserted) {
+                    strings.push_back(text);
+                }
+                serial_write(nodes, res->second);
+                return;
+            }
+
+            serial_write(nodes, n->size());
+            for (const auto &child : *n) {
+                write(child);
+            }
+        }
+    };
+
+    void save_program(const Node &ast, const std::filesystem::path &path) {
+        SerialWriter writer;
+        writer.write(ast);
+
+        std::string header = serial_magic;
+        header += static_cast<char>(serial_version);
+        serial_write(header, writer.strings.size());
+        for (const auto &str : writer.strings) {
+            serial_write(header, str.size());
+            header += str;
+        }
+
+        std::ofstream out(path, std::ios::binary);
+        out << header << writer.nodes;
+        if (!out) {
+            throw std::runtime_error("Could not write " + path.string());
+        }
+    }
+
+    struct SerialReader {
+        std::string_view data;
+        size_t pos = 0;
+        Source strings_source;
+        std::vector<Location> strings;
+
+        SerialReader(std::string_view data) : data(data) {}
+
+        [[noreturn]] static void malformed() {
+            throw std::runtime_error("Malformed binary program");
+        }
+
+        size_t read() {
+            size_t value = 0;
+            for (size_t shift = 0; shift < 64; shift += 7) {
+                if (pos >= data.size()) {
+                    malformed();
+                }
+
+                auto byte = static_cast<uint8_t>(data[pos++]);
+                value |= static_cast<size_t>(byte & 0x7F) << shift;
+                if (!(byte & 0x80)) {
+                    return value;
+                }
+            }
+            malformed();
+        }
+
+        // All strings share one source, so every identifier is a location
+        // into it rather than a source of its own
+        void read_strings(const std::string &origin) {
+            size_t count = read();
+            std::string text;
+            std::vector<std::pair<size_t, size_t>> ranges;
+
+            for (size_t i = 0; i < count; i++) {
+                size_t len = read();
+                if (len > data.size() - pos) {
+                    malformed();
+                }
+
+                ranges.push_back({text.size(), len});
+                text += data.substr(pos, len);
+                pos += len;
+            }
+
+            strings_source = SourceDef::synthetic(text, origin);
+            for (const auto &[start, len] : ranges) {
+                strings.push_back(Location(strings_source, start, len));
+            }
+        }
+
+        // Fresh names end in $ followed by the value of the counter of the
+        // program, this is one past the largest such value
+        size_t fresh_seed() {
+            size_t seed = 0;
+            for (const auto &str : strings) {
+                auto text = str.view();
+                auto dollar = text.rfind('$');
+                if (dollar == std::string_view::npos) {
+                    continue;
+                }
+
+                size_t value;
+                auto begin = text.data() + dollar + 1;
+                auto end = text.data() + text.size();
+                auto [ptr, err] = std::from_chars(begin, end, value);
+                if (err == std::errc() && ptr == end) {
+                    seed = std::max(seed, value + 1);
+                }
+            }
+            return seed;
+        }
+
+        Node read_node() {
+            size_t id = read();
+            if (id >= serial_tokens.size()) {
+                malformed();
+            }
+            const auto &type = serial_tokens[id];
+
+            if (type == Ident || type == Int) {
+                size_t index = read();
+                if (index >= strings.size()) {
+                    malformed();
+                }
+                return type ^ strings[index];
+            }
+
+            auto node = NodeDef::create(type);
+            size_t children = read();
+            for (size_t i = 0; i < children; i++) {
+                node << read_node();
+            }
+            return node;
+        }
+    };
+
+    ProcessResult
+    load_program(const std::filesystem::path &path, bool run_stats) {
+        MappedFile file(path);
+        auto data = file.view();
+        SerialReader reader(data);
+
+        if (data.substr(0, serial_magic.size()) != serial_magic) {
+            throw std::runtime_error(
+                path.string() + " is not a binary program");
+        }
+        reader.pos = serial_magic.size();
+        if (reader.pos >= data.size() ||
+            static_cast<uint8_t>(data[reader.pos++]) != serial_version) {
+            throw std::runtime_error(
+                path.string() + " was written by another version");
+        }
+
+        reader.read_strings(path.string());
+        auto ast = reader.read_node();
+        if (ast != Top || reader.pos != data.size()) {
+            SerialReader::malformed();
+        }
+
+        // The counter of a new Top starts at zero, it is advanced past the
+        // names of the program so later passes do not reuse them
+        for (size_t i = reader.fresh_seed(); i > 0; i--) {
+            ast->fresh();
+        }
+
+        // The program is checked against the normalized form before any
+        // pass uses it
+        Rewriter loader = {
+            "load_program",
+            {gather_stats().cond([=](Node) { return run_stats; })},
+            normalization_wf,
+        };
+        return loader.wf_check_enabled(true).rewrite(ast);
+    }
+}
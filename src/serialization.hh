@@ -0,0 +1,17 @@
+#pragma once
+#include <trieste/trieste.h>
+
+namespace whilelang {
+    using namespace trieste;
+
+    // Writes a normalized program in a compact binary form: a string table
+    // holding the text of every identifier and integer, followed by the
+    // nodes in preorder as token ids with either a string index or the
+    // number of children
+    void save_program(const Node &ast, const std::filesystem::path &path);
+
+    // Rebuilds a program written by save_program without running the
+    // parser, throwing if the file does not hold a valid program
+    ProcessResult
+    load_program(const std::filesystem::path &path, bool run_stats);
+}
@@ -0,0 +1,43 @@
+#include "source.hh"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace whilelang {
+    MappedFile::MappedFile(const std::filesystem::path &path) {
+        int fd = open(path.c_str(), O_RDONLY);
+        if (fd < 0) {
+            throw std::runtime_error("Could not open " + path.string());
+        }
+
+        struct stat info;
+        if (fstat(fd, &info) < 0) {
+            close(fd);
+            throw std::runtime_error("Could not stat " + path.string());
+        }
+
+        size = info.st_size;
+        if (size > 0) {
+            void *mapping = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+            if (mapping == MAP_FAILED) {
+                close(fd);
+                throw std::runtime_error("Could not map " + path.string());
+            }
+
+            // The source is read once from start to end
+            madvise(mapping, size, MADV_SEQUENTIAL);
+            data = static_cast<const char *>(mapping);
+        }
+
+        // The mapping stays valid after the descriptor is closed
+        close(fd);
+    }
+
+    MappedFile::~MappedFile() {
+        if (data) {
+            munmap(const_cast<char *>(data), size);
+        }
+    }
+}
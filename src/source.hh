@@ -0,0 +1,24 @@
+#pragma once
+#include <trieste/trieste.h>
+
+namespace whilelang {
+    using namespace trieste;
+
+    // Read only mapping of a whole file, unmapped when destroyed
+    class MappedFile {
+      public:
+        MappedFile(const std::filesystem::path &path);
+        ~MappedFile();
+
+        MappedFile(const MappedFile &) = delete;
+        MappedFile &operator=(const MappedFile &) = delete;
+
+        inline std::string_view view() const {
+            return {data, size};
+        };
+
+      private:
+        const char *data = nullptr;
+        size_t size = 0;
+    };
+}
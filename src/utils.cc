@@ -88,6 +88,23 @@ namespace whilelang {
         return Int ^ std::to_string(value);
     };
 
+    void gather_assigned_vars(const Node &n, std::set<std::string> &vars) {
+        if (n == Assign) {
+            vars.insert(get_identifier(n / Ident));
+            return;
+        }
+
+        for (auto &child : *n) {
+            gather_assigned_vars(child, vars);
+        }
+    }
+
+    std::set<std::string> get_assigned_vars(const Node &n) {
+        std::set<std::string> vars;
+        gather_assigned_vars(n, vars);
+        return vars;
+    }
+
     void
     log_var_map(std::shared_ptr<std::map<std::string, std::string>> vars_map) {
         const int width = 10;
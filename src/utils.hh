@@ -21,5 +21,8 @@ namespace whilelang {
 
     Node create_const_node(int value);
 
+    // All variables assigned somewhere inside of the node
+    std::set<std::string> get_assigned_vars(const Node &n);
+
 	void log_var_map(std::shared_ptr<std::map<std::string, std::string>> vars_map);
 }
@@ -1,4 +1,8 @@
+#include "analyses/slot_allocation.hh"
+#include "arena.hh"
 #include "lang.hh"
+#include "serialization.hh"
+#include "source.hh"
 #include "utils.hh"
 
 #include <CLI/CLI.hpp>
@@ -22,6 +26,19 @@ int main(int argc, char const *argv[]) {
     bool run_zero_analysis = false;
     bool run_gather_stats = false;
     bool run_mermaid = false;
+    bool run_ssa = false;
+    bool three_pass_cfg = false;
+    bool demand_constants = false;
+    bool no_arena = false;
+    bool run_gvn = false;
+    bool run_licm = false;
+    bool mmap_source = false;
+    size_t parse_jobs = 1;
+    bool fast_parser = false;
+    bool recycle_temps = false;
+    std::filesystem::path emit_ast;
+    bool load_ast = false;
+    whilelang::OptimizationOptions options;
     app.add_flag("-r,--run", run, "Run the program (prompting inputs).");
     app.add_flag(
         "-s,--static-analysis",
@@ -30,7 +47,8 @@ int main(int argc, char const *argv[]) {
     app.add_flag(
         "-z,--zero-analysis",
         run_zero_analysis,
-        "Enable zero analysis in the static analysis. ");
+        "Enable zero analysis in the static analysis, simplifying arithmetic "
+        "with zero operands and comparisons decided by the signs.");
 
     app.add_flag(
         "-p, --print-stats",
@@ -42,33 +60,258 @@ int main(int argc, char const *argv[]) {
         run_mermaid,
         "Runs the mermaid pass which parses the final AST into mermaid "
         "format ");
+    app.add_flag(
+        "--ssa",
+        run_ssa,
+        "Converts the normalized program into SSA form and back, giving "
+        "every assignment its own variable.");
+    app.add_flag(
+        "--three-pass-cfg",
+        three_pass_cfg,
+        "Builds the control flow graph with the three separate gather passes "
+        "instead of the single pass builder, used for benchmarking.");
+    app.add_flag(
+        "--demand-cp",
+        demand_constants,
+        "Resolves constants in constant folding on demand, only exploring "
+        "the definitions each used variable depends on.");
+    app.add_flag(
+        "--no-arena",
+        no_arena,
+        "Allocates the control flow graph and analysis states directly on "
+        "the heap instead of from an arena per optimization round.");
+    app.add_flag(
+        "--gvn",
+        run_gvn,
+        "Enables global value numbering in the static analysis, replacing "
+        "recomputed expressions with the variable already holding the value.");
+    app.add_flag(
+        "--licm",
+        run_licm,
+        "Enables loop invariant code motion in the static analysis, hoisting "
+        "invariant assignments into a guarded preheader of the loop.");
+    app.add_flag(
+        "--inline",
+        options.run_inliner,
+        "Enables inlining of function calls in the static analysis.");
+    app.add_option(
+        "--inline-threshold",
+        options.inline_threshold,
+        "Inlines a call when the size of the callee exceeds the benefit of "
+        "inlining by at most this many statements.");
+    app.add_option(
+        "--inline-budget",
+        options.inline_budget,
+        "Maximum number of statements added by inlining in each round of the "
+        "static analysis.");
+    app.add_flag(
+        "--copy-propagation",
+        options.run_copy_propagation,
+        "Enables copy propagation and coalescing of temporaries in the "
+        "static analysis.");
+    app.add_flag(
+        "--strength-reduction",
+        options.run_strength_reduction,
+        "Enables strength reduction of multiplications of induction "
+        "variables in loops in the static analysis.");
+    app.add_flag(
+        "--partial-eval",
+        options.run_partial_evaluation,
+        "Enables partial evaluation of code in main which does not depend on "
+        "input in the static analysis.");
+    app.add_option(
+        "--partial-eval-budget",
+        options.partial_evaluation_budget,
+        "Maximum number of statements executed by the partial evaluation in "
+        "each round of the static analysis.");
+    app.add_flag(
+        "--tail-recursion",
+        options.run_tail_recursion,
+        "Enables rewriting of tail recursive functions, and recursive "
+        "functions combining the result with + or *, into loops in the "
+        "static analysis.");
+    app.add_flag(
+        "--unroll",
+        options.run_unrolling,
+        "Enables unrolling of loops with trip counts known from constant "
+        "propagation in the static analysis.");
+    app.add_option(
+        "--unroll-budget",
+        options.unroll_budget,
+        "Maximum number of statements added by loop unrolling in each round "
+        "of the static analysis.");
+    app.add_option(
+        "--unroll-factor",
+        options.unroll_factor,
+        "Number of copies of the body in loops which are too large to be "
+        "unrolled completely.");
+    app.add_flag(
+        "--specialize",
+        options.run_specialization,
+        "Enables cloning of functions for calls with constant arguments in "
+        "the static analysis.");
+    app.add_option(
+        "--specialize-limit",
+        options.specialization_limit,
+        "Maximum number of function clones created in each round of the "
+        "static analysis.");
+    app.add_option(
+        "--call-strings",
+        options.call_string_depth,
+        "Analyzes functions separately for each string of up to the given "
+        "number of calls leading to them in constant propagation. Zero "
+        "merges all calls.");
+    app.add_flag(
+        "--slots",
+        options.run_slot_allocation,
+        "Allocates frame slots for the variables of the optimized program, "
+        "sharing slots between variables which are never live together.");
+    app.add_flag(
+        "--mmap",
+        mmap_source,
+        "Maps the input into memory and parses it with the fast parser "
+        "straight from the mapping, without copying the whole file.");
+    app.add_option(
+        "--parse-jobs",
+        parse_jobs,
+        "Number of threads parsing the top level functions of the input in "
+        "parallel before names are resolved in the merged program.");
+    app.add_flag(
+        "--fast-parser",
+        fast_parser,
+        "Parses the input directly into statements with a precedence "
+        "climbing parser, using the regular parser for input it rejects.");
+    app.add_flag(
+        "--recycle-temps",
+        recycle_temps,
+        "Reuses the temporaries introduced by normalization once their "
+        "value has been used, reducing the number of variables.");
+    app.add_option(
+        "--emit-ast",
+        emit_ast,
+        "Writes the normalized program to the given file in a binary form, "
+        "which later runs can read with --load-ast instead of parsing.");
+    app.add_flag(
+        "--load-ast",
+        load_ast,
+        "Reads the input as a normalized program written by --emit-ast.");
     try {
         app.parse(argc, argv);
     } catch (const CLI::ParseError &e) {
         return app.exit(e);
     }
 
+    options.run_zero_analysis = run_zero_analysis;
+    options.log_states = log_level == "Debug" || log_level == "Trace";
+    options.three_pass_cfg = three_pass_cfg;
+    options.demand_constants = demand_constants;
+    options.use_arena = !no_arena;
+    options.run_gvn = run_gvn;
+    options.run_licm = run_licm;
+
     auto vars_map = std::make_shared<std::map<std::string, std::string>>();
-    auto reader =
-        whilelang::reader(vars_map, run_gather_stats, run_mermaid).file(input_path);
+    // Loading and parsing are reported in the same columns as the
+    // passes: name, iterations, changes and time in microseconds
+    using clock = std::chrono::steady_clock;
+    auto log_time = [](const std::string &name,
+                       clock::time_point start,
+                       clock::time_point end) {
+        auto time =
+            std::chrono::duration_cast<std::chrono::microseconds>(end - start);
+        trieste::logging::Info() << name << "\t1\t0\t" << time.count();
+    };
+
+    auto parsed = std::make_shared<clock::time_point>();
+    auto reader = whilelang::reader(
+        vars_map,
+        run_gather_stats,
+        run_mermaid,
+        run_ssa,
+        recycle_temps,
+        [=]() { *parsed = clock::now(); });
 
     try {
         auto program_empty = [](trieste::Node ast) -> bool {
             return ast->front()->empty();
         };
 
-        auto result = reader.read();
+        trieste::ProcessResult result;
+        if (load_ast) {
+            auto load_start = clock::now();
+            result = whilelang::load_program(input_path, run_gather_stats);
+            log_time("load", load_start, clock::now());
+        } else if (mmap_source) {
+            auto load_start = clock::now();
+            whilelang::MappedFile file(input_path);
+            auto load_end = clock::now();
 
+            result = whilelang::read_mapped(
+                file.view(),
+                input_path.string(),
+                vars_map,
+                run_gather_stats,
+                run_mermaid,
+                run_ssa,
+                recycle_temps,
+                [=]() { *parsed = clock::now(); });
+
+            log_time("load", load_start, load_end);
+            log_time("parse", load_end, *parsed);
+        } else {
+            auto load_start = clock::now();
+            auto source = trieste::SourceDef::load(input_path);
+            auto load_end = clock::now();
+
+            result = fast_parser
+                ? whilelang::read_fast(
+                      source,
+                      vars_map,
+                      run_gather_stats,
+                      run_mermaid,
+                      run_ssa,
+                      recycle_temps,
+                      [=]() { *parsed = clock::now(); })
+                : parse_jobs > 1
+                ? whilelang::read_parallel(
+                      source,
+                      parse_jobs,
+                      vars_map,
+                      run_gather_stats,
+                      run_mermaid,
+                      run_ssa,
+                      recycle_temps)
+                : reader.source(source).read();
+
+            // Parsing is interleaved with the passes of the other functions
+            // when parsing in parallel
+            log_time("load", load_start, load_end);
+            if (fast_parser || parse_jobs <= 1) {
+                log_time("parse", load_end, *parsed);
+            }
+        }
+
+        if (result.ok && !emit_ast.empty()) {
+            whilelang::save_program(result.ast, emit_ast);
+        }
+
+        // Filled when slots are allocated, the interpreter then stores the
+        // variables sharing a slot together
+        std::shared_ptr<whilelang::SlotAllocation> slots;
         if (run_static_analysis) {
             do {
-                result = result >>
-                    whilelang::optimization_analysis(run_zero_analysis);
+                result = result >> whilelang::optimization_analysis(options);
             } while (result.ok && result.total_changes > 0 &&
                      !program_empty(result.ast));
+
+            if (result.ok && options.run_slot_allocation &&
+                !program_empty(result.ast)) {
+                slots = std::make_shared<whilelang::SlotAllocation>();
+                result = result >> whilelang::allocate_slots(options, slots);
+            }
         }
 
         if (run)
-            result = result >> whilelang::interpret();
+            result = result >> whilelang::interpret(slots);
 
         // If any result above was not ok it will carry through to here
         if (!result.ok) {
@@ -77,6 +320,14 @@ int main(int argc, char const *argv[]) {
             trieste::logging::Debug() << result.ast;
             return 1;
         }
+        if (run_gather_stats) {
+            trieste::logging::Debug()
+                << "ALLOC CALLS TOTAL: "
+                << whilelang::CountingResource::allocations();
+            trieste::logging::Debug()
+                << "PEAK RSS KB: " << whilelang::peak_rss_kb();
+        }
+
         trieste::logging::Debug() << "AST after all passes: " << std::endl
                                   << result.ast;
         whilelang::log_var_map(vars_map);
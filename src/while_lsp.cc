@@ -0,0 +1,25 @@
+#include "language_server.hh"
+
+#include <CLI/CLI.hpp>
+#include <trieste/trieste.h>
+
+int main(int argc, char const *argv[]) {
+    CLI::App app;
+
+    // Clients start servers with the transport as an argument, stdio is the
+    // only one supported
+    bool stdio = true;
+    app.add_flag(
+        "--stdio", stdio, "Communicate over standard input and output.");
+
+    try {
+        app.parse(argc, argv);
+    } catch (const CLI::ParseError &e) {
+        return app.exit(e);
+    }
+
+    // Log output would be mixed with the messages on standard output
+    trieste::logging::set_log_level_from_string("None");
+
+    return whilelang::run_language_server(std::cin, std::cout);
+}
@@ -4,6 +4,6 @@
 
 int main(int argc, char **argv) {
     auto vars_map = std::make_shared<std::map<std::string, std::string>>();
-    return trieste::Driver(whilelang::reader(vars_map, false, false))
+    return trieste::Driver(whilelang::reader(vars_map, false, false, false, false))
         .run(argc, argv);
 }